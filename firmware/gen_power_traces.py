@@ -0,0 +1,106 @@
+import click
+import numpy as np
+from pathlib import Path
+
+BASE_PATH = Path(__file__).resolve().parent
+
+# Samples every 0.1s, SIM_POWER_TICKS in tests/energy_sim.h
+SAMPLE_S = 0.1
+
+
+def write_trace(path: Path, description, power):
+    with open(path, "w") as f:
+        f.write("# Harvested power in uW, one sample per 0.1s\n")
+        for line in description:
+            f.write(f"# {line}\n")
+        for p in power:
+            f.write(f"{int(round(max(p, 0)))}\n")
+    click.echo(f"{path}: {len(power)} samples, mean {np.mean(power):.1f}uW")
+
+
+def office_shadows(rng, n):
+    """Office desk, people passing cast short shadows"""
+    p = 100 * (1 + 0.05 * rng.standard_normal(n))
+    t = 0
+    while True:
+        t += int(rng.exponential(300))
+        if t >= n:
+            break
+        d = int(rng.uniform(5, 30))
+        p[t : t + d] *= rng.uniform(0.3, 0.6)
+    return p
+
+
+def daylight_dimming(rng, n):
+    """Window seat with a slow daylight swing and passing clouds"""
+    t = np.arange(n)
+    p = 40 + 80 * (1 + np.sin(2 * np.pi * t / 6000)) + 0.1 * 120 * rng.standard_normal(n)
+    cloud = np.ones(n)
+    t = 0
+    while True:
+        t += int(rng.exponential(1500))
+        if t >= n:
+            break
+        d = int(rng.uniform(100, 600))
+        cloud[t : t + d] = rng.uniform(0.4, 0.7)
+    return p * cloud
+
+
+def occupancy_off(rng, n):
+    """Meeting room, occupancy sensor switches the lights off"""
+    p = 120 * (1 + 0.05 * rng.standard_normal(n))
+    t = 0
+    while True:
+        t += int(rng.uniform(1800, 3000))
+        if t >= n:
+            break
+        d = min(int(rng.uniform(300, 1200)), n - t)
+        p[t : t + d] = 3 + rng.standard_normal(d)
+    return p
+
+
+@click.command(short_help="Generates synthetic harvested power traces for test_vthr")
+@click.option(
+    "--output-dir",
+    "-o",
+    type=click.Path(file_okay=False),
+    default=str(BASE_PATH / "_build" / "host" / "traces"),
+    help="Directory for the .power traces",
+)
+@click.option("--seed", type=int, default=7, show_default=True)
+@click.option("--duration", type=float, default=1200.0, show_default=True, help="Trace length in s")
+def build(output_dir, seed, duration):
+    # All traces draw from one generator, so their order must not change
+    rng = np.random.default_rng(seed)
+    n = int(round(duration / SAMPLE_S))
+    out = Path(output_dir)
+    out.mkdir(parents=True, exist_ok=True)
+
+    write_trace(
+        out / "office_shadows.power",
+        [
+            "Office desk at 100uW, people passing cast 0.5-3s shadows of 30-60%",
+            "about every 30s, 5% noise",
+        ],
+        office_shadows(rng, n),
+    )
+    write_trace(
+        out / "daylight_dimming.power",
+        [
+            "Window seat between 40 and 200uW with a 10 minute swing, clouds cut",
+            "40-70% for 10-60s, 10% noise",
+        ],
+        daylight_dimming(rng, n),
+    )
+    write_trace(
+        out / "occupancy_off.power",
+        [
+            "Meeting room at 120uW, occupancy sensor switches lights off for",
+            "30-120s every 3-5 minutes, 3uW of ambient light remain",
+        ],
+        occupancy_off(rng, n),
+    )
+
+
+if __name__ == "__main__":
+    build()
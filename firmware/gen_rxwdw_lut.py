@@ -0,0 +1,92 @@
+import click
+import textwrap
+import numpy as np
+from pathlib import Path
+
+from neslab.find.energy import cap_energy, optimal_margins
+
+BASE_PATH = Path(__file__).resolve().parent
+
+
+@click.command(short_help="Generates lookup table of RX window margins over voltage")
+@click.option(
+    "--output-path",
+    "-o",
+    type=click.Path(dir_okay=False),
+    default=str(BASE_PATH / "include" / "rxwdw_lut.h"),
+    help="Output path for C header",
+)
+@click.option(
+    "--v-min",
+    type=float,
+    default=3.0,
+    show_default=True,
+    help="Voltage down to which rounds may spend energy, V_THR_ROUND in src/main.c",
+)
+@click.option(
+    "--v-max",
+    type=float,
+    default=3.5,
+    show_default=True,
+    help="Highest voltage, V_THR_MAX in src/main.c",
+)
+@click.option("--v-step", type=float, default=0.025, show_default=True)
+@click.option(
+    "--min-margin",
+    type=int,
+    default=22,
+    show_default=True,
+    help="Shortest margin in RTC ticks, RX_WDW_TCKS in src/main.c",
+)
+@click.option("--max-margin", type=int, default=130, show_default=True)
+@click.option(
+    "--sigma",
+    type=float,
+    default=4.0,
+    show_default=True,
+    help="Standard deviation of the offset of synchronized neighbors in RTC ticks",
+)
+@click.option(
+    "--p-sync",
+    type=float,
+    default=0.8,
+    show_default=True,
+    help="Fraction of synchronized neighbors",
+)
+@click.pass_context
+def build(ctx, output_path, v_min, v_max, v_step, min_margin, max_margin, sigma, p_sync):
+
+    voltages = v_min + np.arange(int(round((v_max - v_min) / v_step)) + 1) * v_step
+    energies = np.array([cap_energy(v, v_min) for v in voltages])
+    margins, value = optimal_margins(
+        energies, np.arange(min_margin, max_margin + 1, 2), sigma=sigma, p_sync=p_sync
+    )
+    for v, m, n in zip(voltages, margins, value):
+        click.echo(f"{v:.3f}V: margin {m:3d} ticks, {n:.2f} expected rendezvous")
+
+    # Wrap entries into lines of a multi-line macro
+    lines = textwrap.wrap(", ".join(str(m) for m in margins) + " }", 74)
+    lines[0] = "{ " + lines[0]
+    entries = " \\\n".join(f"  {line:<76}" for line in lines).rstrip(" ")
+    Path(output_path).write_text(
+        f"""#ifndef __RXWDW_LUT_H_
+#define __RXWDW_LUT_H_
+
+/* Generated by gen_rxwdw_lut.py with sigma {sigma} and p_sync {p_sync} */
+
+/* Voltage of the first entry and between entries */
+#define RXWDW_LUT_V_MIN {v_min}
+#define RXWDW_LUT_V_STEP {v_step}
+#define RXWDW_LUT_LEN {len(margins)}
+
+/* RX window margin in RTC ticks, 0 if no full round fits */
+#define RXWDW_LUT                                                              \\
+{entries}
+
+#endif /* __RXWDW_LUT_H_ */
+"""
+    )
+
+
+if __name__ == "__main__":
+    build()
@@ -12,6 +12,53 @@ colors = prop_cycle.by_key()["color"]
 
 BASE_PATH = Path(__file__).resolve().parent
 
+# Layout of the table, must match LUT_* definitions in include/prng.h
+TCHR_STEP = 10
+TCHR_LEN = 256
+DENSITY_MIN = 2
+DENSITY_STEP = 2
+DENSITY_LEN = 16
+
+
+def load_scales(input_path):
+    """Loads fitted scales as (t_chr x n_nodes) frame
+
+    Accepts results from reproducibility/fit_scale.py with columns t_chr, n_nodes
+    and scale or the legacy two-node table with columns t_chr and x_opt.
+    """
+    df = pd.read_csv(input_path)
+    if "n_nodes" not in df.columns:
+        df["n_nodes"] = 2
+    if "scale" not in df.columns:
+        df["scale"] = df["x_opt"]
+
+    df = df.pivot_table(index="t_chr", columns="n_nodes", values="scale")
+    df.sort_index(inplace=True)
+    return df
+
+
+def resample(df):
+    """Interpolates fitted scales onto the regular grid used by the firmware
+
+    Charging times and densities outside of the fitted range take the scale of
+    the closest fitted point.
+    """
+    t_chrs = np.arange(1, TCHR_LEN + 1) * TCHR_STEP
+    densities = DENSITY_MIN + np.arange(DENSITY_LEN) * DENSITY_STEP
+
+    # First interpolate every fitted density along the charging time
+    by_tchr = np.empty((TCHR_LEN, len(df.columns)))
+    for j, n_nodes in enumerate(df.columns):
+        series = df[n_nodes].dropna()
+        by_tchr[:, j] = np.interp(t_chrs, series.index, series.values)
+
+    # Then interpolate every charging time along the density
+    table = np.empty((TCHR_LEN, DENSITY_LEN))
+    for i in range(TCHR_LEN):
+        table[i, :] = np.interp(densities, df.columns, by_tchr[i, :])
+
+    return table
+
 
 @click.command(
     short_help="Generates binary lookup table for optimized scale of geometric distro"
@@ -33,13 +80,11 @@ BASE_PATH = Path(__file__).resolve().parent
 @click.pass_context
 def build(ctx, input_path, output_path):
 
-    df = pd.read_csv(input_path, index_col="t_chr")
-    df.sort_index(inplace=True)
-    df = df.reindex(np.arange(10, df.index[-1] - 30, 10))
-    df.interpolate(inplace=True)
+    table = resample(load_scales(input_path))
 
-    table = df["x_opt"].values.astype(np.float32)
-    table.tofile(Path(output_path))
+    # Store as unsigned Q0.16 fixed point, row-major over (t_chr, density)
+    table = np.clip(np.round(table * (1 << 16)), 1, (1 << 16) - 1)
+    table.astype("<u2").tofile(Path(output_path))
 
 
 if __name__ == "__main__":
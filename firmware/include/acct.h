@@ -0,0 +1,152 @@
+#ifndef __ACCT_H_
+#define __ACCT_H_
+
+#include <stdint.h>
+
+/* Bin k counts durations from 2^(k-1) up to 2^k-1 RTC ticks, bin 0 those of
+ * zero ticks. The last bin collects everything from 2^(ACCT_HIST_BINS-2)
+ * ticks, i.e. 128 seconds. */
+#define ACCT_HIST_BINS 24
+
+/* Report accounting in the log every this many completed cycles */
+#define ACCT_REPORT_CYCLES 64
+
+/* Words of the log ring taken by a report, see acct_report() */
+#define ACCT_REPORT_WORDS (2 + 3 + ACCT_N_PHASES * (2 + 6))
+
+#ifdef ACCT_HOST
+/* Flync period that host builds account with, 100Hz flicker */
+#define ACCT_HOST_PERIOD 327
+#endif
+
+/* Phases of a charging cycle in protocol() */
+enum AcctPhase {
+  /* Charging up to the turn-on threshold, starts after initialization */
+  ACCT_CHARGE = 0,
+  /* Waiting for the randomized wake-up time */
+  ACCT_WAIT = 1,
+  /* Discovery rounds, including extra rounds */
+  ACCT_DISCO = 2,
+  /* Sleeping after the last round until the power-fail warning */
+  ACCT_POF = 3,
+  ACCT_N_PHASES = 4
+};
+
+/* Radio states accounted by the discovery */
+enum AcctRadio { ACCT_RADIO_TX = 0, ACCT_RADIO_RX = 1, ACCT_N_RADIO = 2 };
+
+typedef struct {
+  /* Number of times the phase was completed */
+  uint32_t n;
+  /* Total duration in flync ticks and in RTC ticks */
+  uint32_t tcks;
+  uint32_t rtc;
+  /* Resets while in this phase before the power-fail warning */
+  uint32_t brownouts;
+  /* Number of phases by binary logarithm of their duration in RTC ticks */
+  uint32_t hist[ACCT_HIST_BINS];
+} acct_phase_t;
+
+typedef struct {
+  /* Marks the block as initialized after a cold boot */
+  uint32_t magic;
+
+  /* Current phase and the time it was entered */
+  uint32_t phase;
+  uint32_t t_enter;
+  uint32_t rtc_enter;
+
+  /* Charging cycles that reached the power-fail warning */
+  uint32_t n_cycles;
+  /* Set when the power-fail warning closed a cycle, until the next cycle
+   * has charged up, as the reset in between is expected */
+  uint32_t pof;
+
+  acct_phase_t phases[ACCT_N_PHASES];
+
+  /* Total time the radio spent in TX and RX in RTC ticks */
+  uint32_t radio_rtc[ACCT_N_RADIO];
+} acct_state_t;
+
+/**
+ * Initializes accounting
+ *
+ * Counters are kept in retained RAM and only reset if the retained block is
+ * not valid, i.e. after a cold boot. A reset is counted as a brownout of the
+ * phase it interrupted, unless the power-fail warning closed the previous
+ * cycle and the node hasn't charged up since. Enters ACCT_CHARGE.
+ *
+ * @returns 0 if retained state was recovered, 1 if it was reset
+ */
+int acct_init(void);
+
+/**
+ * Closes the current phase and enters the next one
+ *
+ * Timestamps the transition with the system time and the RTC counter and
+ * adds the duration of the closed phase to its histogram. Entering
+ * ACCT_CHARGE from ACCT_POF completes a cycle and must be done as soon as the
+ * power-fail warning fires, as the node usually resets shortly after.
+ *
+ * @param phase Phase to enter
+ *
+ */
+void acct_enter(enum AcctPhase phase);
+
+/**
+ * Timestamps the RTC for measuring radio time
+ *
+ * @returns Current RTC counter
+ */
+uint32_t acct_radio_start(void);
+
+/**
+ * Adds the time since acct_radio_start to the radio time
+ *
+ * Only valid for intervals shorter than a flync period.
+ *
+ * @param radio Radio state
+ * @param rtc_start RTC counter returned by acct_radio_start
+ *
+ * @returns Accounted time in RTC ticks
+ */
+unsigned int acct_radio_stop(enum AcctRadio radio, uint32_t rtc_start);
+
+/**
+ * Adds time to the radio time
+ *
+ * @param radio Radio state
+ * @param rtc_tcks Time in RTC ticks
+ *
+ */
+void acct_radio_add(enum AcctRadio radio, unsigned int rtc_tcks);
+
+/**
+ * Writes counters to the log every ACCT_REPORT_CYCLES cycles
+ *
+ * Logs the radio times and one line per phase with its count, duration and
+ * brownouts. The histogram is summarized by its most frequent and its highest
+ * bin and can be read in full from acct_stats(). The report takes
+ * ACCT_REPORT_WORDS of the log ring.
+ *
+ */
+void acct_report(void);
+
+/**
+ * Counters for readout
+ *
+ * @returns Reference to retained accounting state
+ */
+const acct_state_t *acct_stats(void);
+
+#ifdef ACCT_HOST
+/**
+ * Sets the system time and RTC counter that host builds account with
+ *
+ * @param now System time in flync ticks
+ * @param rtc RTC counter within the flync period
+ *
+ */
+void acct_host_clock(uint32_t now, uint32_t rtc);
+#endif
+#endif /* __ACCT_H_ */
@@ -0,0 +1,64 @@
+#ifndef __CHARGE_H_
+#define __CHARGE_H_
+
+#include "pt.h"
+
+/* SAADC code of a supply voltage, as compared by the charge monitor */
+#define ADC_GAIN 1 / 6
+#define ADC_REF 0.6
+#define ADC_BITS 10
+
+#define V2ADC(x) (unsigned int)((x) * ADC_GAIN / ADC_REF * (1 << ADC_BITS))
+
+/**
+ * Initializes charge monitor
+ *
+ * Uses the limit comparators of the SAADC channel that samples the supply
+ * voltage on every flync tick. The CPU is only woken up when a sample crosses
+ * one of the armed thresholds instead of on every conversion.
+ *
+ * @returns 0 on success
+ */
+int charge_init(void);
+
+/**
+ * Requests event for rising supply voltage
+ *
+ * Event is set on the first conversion above the given level. Only one rising
+ * threshold can be armed at a time, a new request replaces the previous one.
+ *
+ * @param v_level Threshold in binary ADC code
+ *
+ * @returns Event to be set
+ */
+volatile pt_event_t *charge_above(unsigned int v_level);
+
+/**
+ * Requests event for falling supply voltage
+ *
+ * Event is set on the first conversion below the given level. Only one falling
+ * threshold can be armed at a time, a new request replaces the previous one.
+ *
+ * @param v_level Threshold in binary ADC code
+ *
+ * @returns Event to be set
+ */
+volatile pt_event_t *charge_below(unsigned int v_level);
+
+/**
+ * Disarms both thresholds
+ *
+ * @returns 0 on success
+ */
+int charge_cancel(void);
+
+/**
+ * Handles limit events of the supply voltage channel
+ *
+ * Must be called from the SAADC interrupt handler, unless the charge monitor
+ * owns it.
+ *
+ */
+void _charge_limit(void);
+
+#endif /* __CHARGE_H_ */
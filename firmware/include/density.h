@@ -0,0 +1,102 @@
+#ifndef __DENSITY_H_
+#define __DENSITY_H_
+
+#include <stdint.h>
+
+#include "radio.h"
+
+/* Fraction bits of fixed point density estimate, same as scale LUT */
+#define DENSITY_FRAC_BITS 8
+
+/* Fraction bits of the heard and expected packet accumulators */
+#define DENSITY_ACC_FRAC_BITS 16
+
+/* Estimate averages over as many cycles as it takes to expect this many
+ * packets from every neighbor */
+#define DENSITY_HORIZON 8
+
+/* Upper bound for density estimate in number of nodes */
+#define DENSITY_MAX 64
+
+typedef struct {
+  /* Marks the block as initialized after a cold boot */
+  uint32_t magic;
+
+  /* Packets received in current RX window */
+  uint16_t win_bcn;
+  uint16_t win_ack_yes;
+  uint16_t win_ack_no;
+  uint16_t win_crc_err;
+
+  /* Totals since last cold boot */
+  uint32_t n_windows;
+  uint32_t n_bcn;
+  uint32_t n_ack_yes;
+  uint32_t n_ack_no;
+  uint32_t n_crc_err;
+
+  /* Decaying sums of contenders heard per RX window and of the number of
+   * times a single neighbor is expected to be heard */
+  uint32_t heard;
+  uint32_t expected;
+  /* Estimated number of nodes in the clique, including this node */
+  uint32_t density;
+} density_state_t;
+
+/**
+ * Initializes density estimation
+ *
+ * Counters and estimate are kept in retained RAM. They are only reset if the
+ * retained block is not valid, i.e. after a cold boot.
+ *
+ * @returns 0 if retained state was recovered, 1 if it was reset
+ */
+int density_init(void);
+
+/**
+ * Counts a correctly received packet
+ *
+ * @param type Logical address on which packet was received
+ *
+ */
+void density_count(enum RadioLogicalAddress type);
+
+/**
+ * Counts a packet that was received with CRC error
+ *
+ */
+void density_count_crc_error(void);
+
+/**
+ * Closes the current RX windows and updates the density estimate
+ *
+ * Every neighbor with a similar charging cycle is active in the same slot
+ * with probability of roughly its number of rounds over the cycle length, so
+ * it is expected to be heard n_windows^2 / cycle_tcks times per cycle. The
+ * contenders heard over the expected hearings of a single neighbor estimate
+ * the number of neighbors. Both sums decay with the listen duty cycle, so
+ * that the estimate always averages over DENSITY_HORIZON expected hearings,
+ * no matter how rarely the node listens.
+ *
+ * @param cycle_tcks Length of the last charging cycle in flync ticks
+ * @param n_windows Number of RX windows in the last charging cycle
+ *
+ */
+void density_update(unsigned int cycle_tcks, unsigned int n_windows);
+
+/**
+ * Current density estimate
+ *
+ * @returns Estimated number of nodes in fixed point with DENSITY_FRAC_BITS
+ * fraction bits
+ */
+unsigned int density_get(void);
+
+/**
+ * Counters and estimate for readout
+ *
+ * @returns Reference to retained density state
+ */
+const density_state_t *density_stats(void);
+
+#endif /* __DENSITY_H_ */
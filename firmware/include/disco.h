@@ -7,16 +7,33 @@
 
 #include "pt.h"
 #include "radio.h"
+#include "subslot.h"
 
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 
+/* Number of recently heard neighbors gossiped in every beacon and
+ * acknowledgement, 0 for the plain PDU. Every short ID adds two bytes of
+ * airtime. In a simulated building (../model/examples/compare_gossip.py),
+ * four IDs teach nodes their two-hop topology the fastest. */
+#define DISCO_GOSSIP_IDS 0
+
 typedef struct {
   /* ID of discovered node */
   uint32_t device_id;
   /* RSSI of packet from discovered node */
   uint8_t rssi;
+  /* Charging time advertised by discovered node */
+  uint16_t t_chr;
+  /* Next planned wakeup of discovered node in own system time */
+  uint32_t t_next;
+  /* TX power of discovered node in dBm */
+  int8_t tx_power;
+#if DISCO_GOSSIP_IDS > 0
+  /* Short IDs of neighbors the discovered node heard most recently */
+  uint16_t gossip[DISCO_GOSSIP_IDS];
+#endif
   /* Type of beacon */
   enum RadioLogicalAddress type;
 } disco_data_t;
@@ -26,8 +43,29 @@ typedef struct __attribute__((packed)) {
   uint32_t device_id;
   /* Current charging time */
   uint16_t t_chr;
+  /* Slots from the round to the sender's next planned wakeup. FLYNC aligns
+   * the slots of all nodes, so this needs no offset between their clocks. */
+  uint16_t next_delta;
+  /* Sender's TX power in dBm */
+  int8_t tx_power;
+#if DISCO_GOSSIP_IDS > 0
+  /* Short IDs of neighbors the sender heard most recently, 0 if unused */
+  uint16_t gossip[DISCO_GOSSIP_IDS];
+#endif
 } disco_pdu_t;
 
+/* Number of receive buffers, must be a power of two */
+#define DISCO_RX_BUFS 4
+
+typedef struct {
+  /* CRC status of received packet */
+  uint8_t crc_ok;
+  /* Logical address on which packet was received */
+  uint8_t rxmatch;
+  /* RSSI of received packet in -dBm */
+  uint8_t rssi;
+} disco_rx_meta_t;
+
 typedef pt_queue(disco_data_t, 16) disco_queue_t;
 /**
  * Retrieves result of previous discovery.
@@ -52,31 +90,34 @@ int disco_init(unsigned int gpio_pin);
 /**
  * Executes discovery as protothread.
  *
- * Schedules to start HFCLK and then send a beacon at given phase. After
- * sending the beacon, radio is turned around to listen for acknowledgement
- * of beacon from another node. Stops RX if packet is received, voltage drops
- * below fixed threshold, or after given number of RTC ticks. Result is stored
- * internally and must be retrieved by the user.
+ * Tunes the radio to the channel of the current hop slot, or to the meeting
+ * channel if neighbors were told to wake up for this round, schedules to start
+ * HFCLK and then send a beacon in one of the sub-slots after the given phase,
+ * at most DISCO_SUBSLOTS of them as fit into the flync period. A sub-slot that
+ * leaves no room for the HFCLK lead is passed over for a later one, and the
+ * round ends without a beacon if none is left. The RX window is extended to
+ * cover all later sub-slots. After sending the beacon, radio is
+ * turned around to listen for acknowledgement of beacon from another node.
+ * Received packets are stored in a ring of DISCO_RX_BUFS buffers, so that
+ * reception continues while earlier packets are processed. Stops RX after the
+ * given number of valid packets or after given number of RTC ticks. Result is
+ * stored internally and must be retrieved by the user.
  *
  * @param pt Reference to the thread struct managing this thread
- * @param rx_wdw_tcks Length of RX window in RTC ticks
+ * @param t_chr Own charging time, advertised in beacon and acknowledgement
+ * @param t_next Own next planned wakeup in system time, advertised in beacon
+ * and acknowledgement
+ * @param rx_wdw_tcks Margin of the RX window in RTC ticks on top of the airtime
+ * of beacon and acknowledgement in the current radio profile
  * @param start_time_tcks Time at which beacon should be sent
+ * @param exit_pkts Number of valid packets that close the RX window early.
+ * Provide 0 to always listen for the full window.
+ * @param meet True if the round is a planned meeting with known neighbors
  *
  */
-void disco_thread(struct pt *pt, uint16_t t_chr, unsigned int rx_wdw_tcks,
-                  unsigned int start_time_tcks);
-
-/**
- * Formats a string with results from discovery.
- *
- * @param buf Buffer where formatted string should be stored
- * @param disco_data Discovery data
- * @param t_chr Current charging time
- * @param buf_size Length of buffer
- *
- */
-int disco_strfmt(char *buf, disco_data_t *disco_data, unsigned int t_chr,
-                 size_t buf_size);
+void disco_thread(struct pt *pt, uint16_t t_chr, uint32_t t_next,
+                  unsigned int rx_wdw_tcks, unsigned int start_time_tcks,
+                  unsigned int exit_pkts, bool meet);
 
 /**
  * Convenience wrapper for running discovery.
@@ -91,10 +132,12 @@ int disco_strfmt(char *buf, disco_data_t *disco_data, unsigned int t_chr,
  * @param params Parameters for discovery
  *
  */
-#define pt_disco(pt, pt_disco, t_chr, rx_wdw_tcks, start_time_tcks)            \
+#define pt_disco(pt, pt_disco, t_chr, t_next, rx_wdw_tcks, start_time_tcks,   \
+                 exit_pkts, meet)                                              \
   *pt_disco = (const struct pt){0};                                            \
   pt_loop(pt, pt_status(pt_disco) == PT_STATUS_BLOCKED) {                      \
-    disco_thread(pt_disco, t_chr, rx_wdw_tcks, start_time_tcks);               \
+    disco_thread(pt_disco, t_chr, t_next, rx_wdw_tcks, start_time_tcks,        \
+                 exit_pkts, meet);                                             \
   }
 
 #endif /* __DISCO_H_ */
\ No newline at end of file
@@ -12,6 +12,13 @@
 
 #define FLYNC_ACTIVE 1
 
+/* Timestamp and count clock edges in hardware instead of waking up the CPU on
+ * every edge and every flync tick */
+#define FLYNC_HW_CAPTURE 1
+
+/* Maximum number of clock edges between two PLL updates once locked */
+#define FLYNC_DECIM_MAX 8
+
 /* Used to disable debug GPIO pin */
 #define FLYNC_NO_GPIO 32
 
@@ -25,7 +32,16 @@
 
 #define FLYNC_LED 25
 
-#define FLYNC_CLOCK_FREQ_HZ 100UL
+/* Lamps flicker at twice the grid frequency of 50Hz or 60Hz */
+#define FLYNC_CLOCK_FREQ_100HZ 100UL
+#define FLYNC_CLOCK_FREQ_120HZ 120UL
+/* Used before calibration and if the measured rate matches neither grid */
+#define FLYNC_CLOCK_FREQ_DEFAULT FLYNC_CLOCK_FREQ_100HZ
+
+/* Number of flicker periods averaged to detect the flicker rate */
+#define FLYNC_CAL_PERIODS 4
+/* Calibration is repeated if spurious edges distort the measurement */
+#define FLYNC_CAL_ATTEMPTS 8
 
 /**
  * Initializes FLYNC clock
@@ -36,6 +52,38 @@
  */
 int flync_init(unsigned int gpio_pin);
 
+/**
+ * Returns current flync period
+ *
+ * The RTC is cleared after this many ticks, i.e. on every flync tick.
+ *
+ * @returns Current flync period in RTC ticks
+ */
+unsigned int flync_period(void);
+
+/**
+ * Exports state of the PLL
+ *
+ * Allows to keep the PLL state across brownouts, so that flync_init can skip
+ * calibration after a warm boot.
+ *
+ * @param period Current flync period in RTC ticks
+ * @param freq Estimated flicker period with PLL_FRAC_BITS fraction bits
+ *
+ * @returns 0 on success
+ */
+int flync_save(uint32_t *period, int32_t *freq);
+
+/**
+ * Free-runs the RTC during predicted MPPT gaps
+ *
+ * Must be called on every flync tick while the RTC compare interrupt is
+ * enabled. With FLYNC_HW_CAPTURE, this interrupt is only enabled around MPPT
+ * gaps learned by the PLL, where edges cannot be used to discipline the RTC.
+ *
+ */
+void _flync_tick(void);
+
 /**
  * Converts powerline phase to rtc ticks
  *
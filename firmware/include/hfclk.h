@@ -0,0 +1,67 @@
+#ifndef __HFCLK_H_
+#define __HFCLK_H_
+
+#include <stdint.h>
+
+/* Lead of HFCLK start before the beacon in RTC ticks after a cold boot, and
+ * the longest one ever used */
+#define HFCLK_LEAD_MAX 40
+
+/* Ticks added to the estimated startup latency for RTC resolution and
+ * interrupt latency */
+#define HFCLK_GUARD_TCKS 2
+
+/* Fractional bits of the latency estimate */
+#define HFCLK_FRAC_BITS 8
+
+/* Estimate decays towards shorter latencies by 1/2^HFCLK_DECAY_SHIFT of the
+ * difference per sample */
+#define HFCLK_DECAY_SHIFT 8
+
+typedef struct {
+  /* Marks the block as initialized after a cold boot */
+  uint32_t magic;
+  /* Startup latency estimate in RTC ticks with HFCLK_FRAC_BITS */
+  uint32_t latency;
+  /* Number of measurements and of those that exceeded the lead in use */
+  uint32_t n;
+  uint32_t late;
+} hfclk_state_t;
+
+/**
+ * Initializes HFCLK startup calibration
+ *
+ * Latency estimate is kept in retained RAM and only reset to the lead of
+ * HFCLK_LEAD_MAX if the retained block is not valid, i.e. after a cold boot.
+ *
+ * @returns 0 if retained state was recovered, 1 if it was reset
+ */
+int hfclk_init(void);
+
+/**
+ * Updates startup latency estimate with a measurement
+ *
+ * Estimate follows longer latencies immediately and decays slowly towards
+ * shorter ones, so that it tracks the slowest recent startups.
+ *
+ * @param latency_tcks RTC ticks from HFCLKSTART to HFCLKSTARTED
+ *
+ */
+void hfclk_update(unsigned int latency_tcks);
+
+/**
+ * Lead of HFCLK start before the beacon
+ *
+ * @returns Estimated startup latency plus HFCLK_GUARD_TCKS in RTC ticks, at
+ * most HFCLK_LEAD_MAX
+ */
+unsigned int hfclk_lead(void);
+
+/**
+ * Calibration state for readout
+ *
+ * @returns Reference to retained calibration state
+ */
+const hfclk_state_t *hfclk_stats(void);
+
+#endif /* __HFCLK_H_ */
@@ -0,0 +1,126 @@
+#ifndef __LOG_H_
+#define __LOG_H_
+
+#include <stdint.h>
+
+/* Set to 0 to remove all log statements at compile time */
+#define LOG_ENABLED 1
+
+/* Size of the log ring in 32-bit words, must be a power of two */
+#define LOG_BUF_WORDS 256
+/* Maximum number of arguments per log statement */
+#define LOG_MAX_ARGS 6
+
+/* Upper byte of every record header, allows the decoder to resynchronize */
+#define LOG_MAGIC 0xA5UL
+/* Format ID of records reporting the number of dropped records */
+#define LOG_ID_DROPPED 0xFFFFFUL
+
+/*
+ * Record header: LOG_MAGIC in bits 24-31, number of arguments in bits 20-23
+ * and format ID in bits 0-19. The header is followed by the system time in
+ * flync ticks and the raw arguments, one word each.
+ */
+#define LOG_HEADER(id, nargs)                                                  \
+  ((LOG_MAGIC << 24) | ((uint32_t)(nargs) << 20) | ((uint32_t)(id)&0xFFFFF))
+
+#define _LOG_NARGS(_0, _1, _2, _3, _4, _5, _6, n, ...) n
+#define LOG_NARGS(...) _LOG_NARGS(0, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+
+#if LOG_ENABLED
+/**
+ * Logs a message without formatting it
+ *
+ * The format string is placed in the non-allocated .logstr section of the
+ * ELF and never ends up on the node. Its offset in that section serves as
+ * format ID. Only the ID and the arguments are written into the log ring,
+ * log_decode.py reconstructs the text on the host. Arguments are passed as
+ * 32-bit words, so only integer conversions are supported.
+ *
+ * Safe to call from interrupt handlers. Records that don't fit into the ring
+ * are dropped and counted.
+ *
+ * @param fmt printf-style format string literal
+ *
+ */
+#define log_printf(fmt, ...)                                                   \
+  do {                                                                         \
+    static const char _log_fmt[]                                               \
+        __attribute__((section(".logstr"), used)) = fmt;                       \
+    _Static_assert(LOG_NARGS(__VA_ARGS__) <= LOG_MAX_ARGS,                     \
+                   "too many log arguments");                                  \
+    _log_write((uint32_t)(uintptr_t)_log_fmt, LOG_NARGS(__VA_ARGS__),          \
+               ##__VA_ARGS__);                                                 \
+  } while (0)
+#else
+#define log_printf(fmt, ...)                                                   \
+  do {                                                                         \
+  } while (0)
+#endif
+
+/**
+ * Initializes UARTE for draining the log
+ *
+ * @param pseltxd TX pin
+ *
+ * @returns 0 on success
+ */
+int log_init(uint32_t pseltxd);
+
+/**
+ * Starts draining the log ring over UARTE
+ *
+ * Transfers the records with EasyDMA in the background, the CPU only wakes up
+ * once per contiguous chunk. Draining continues until the ring is empty or
+ * log_stop is called, so it should only be started when there is surplus
+ * energy.
+ *
+ */
+void log_drain(void);
+
+/**
+ * Stops draining after the current DMA transfer
+ *
+ */
+void log_stop(void);
+
+/**
+ * Returns number of words waiting in the log ring
+ *
+ * @returns Number of words not yet transferred
+ */
+unsigned int log_pending(void);
+
+/**
+ * Writes a record into the log ring
+ *
+ * Use log_printf instead, which places the format string and counts the
+ * arguments.
+ *
+ * @param id Address of the format string in the .logstr section
+ * @param nargs Number of 32-bit arguments that follow
+ *
+ */
+void _log_write(uint32_t id, unsigned int nargs, ...);
+
+#ifdef LOG_HOST
+/**
+ * Sets the system time that host builds record instead of timer_now
+ *
+ * @param now System time in flync ticks
+ *
+ */
+void log_host_clock(uint32_t now);
+
+/**
+ * Takes the oldest words out of the log ring, as draining would
+ *
+ * @param words Destination of the words
+ * @param max Maximum number of words to take
+ *
+ * @returns Number of words taken
+ */
+unsigned int log_host_read(uint32_t *words, unsigned int max);
+#endif
+
+#endif /* __LOG_H_ */
@@ -0,0 +1,201 @@
+#ifndef __NEIGHBOR_H_
+#define __NEIGHBOR_H_
+
+#include <stdint.h>
+
+/* Number of table entries, must be a power of two */
+#define NBR_CAPACITY 32
+/* Number of slots searched from the hashed position */
+#define NBR_PROBE_LEN 8
+/* Entries not heard for this many cycles are evicted */
+#define NBR_MAX_AGE 256
+
+/* Fraction bits of RSSI moving average */
+#define NBR_RSSI_FRAC_BITS 4
+/* Weight of new sample in RSSI moving average is 1/2^NBR_RSSI_SHIFT */
+#define NBR_RSSI_SHIFT 2
+
+/* Planned wakeups leave a margin of 1/2^NBR_PLAN_SHIFT of the charging time
+ * for the next charging cycle to take longer */
+#define NBR_PLAN_SHIFT 1
+/* Missed meetings are retried this many times before falling back to random
+ * waits until the neighbor is discovered again */
+#define NBR_MEET_RETRIES 2
+
+/* Number of two-hop neighbors kept per neighbor from its gossip */
+#define NBR_TWO_HOP 4
+
+typedef struct {
+  /* ID of neighbor, 0 marks an unused entry */
+  uint32_t device_id;
+  /* Cycle in which neighbor was last heard */
+  uint32_t last_seen;
+  /* Moving average of RSSI in -dBm with NBR_RSSI_FRAC_BITS fraction bits */
+  uint16_t rssi;
+  /* Charging time advertised by neighbor in flync ticks */
+  uint16_t t_chr;
+  /* Interval at which missed meetings are retried in flync ticks */
+  uint16_t meet_intvl;
+  /* Next planned meeting in own system time */
+  uint32_t t_meet;
+  /* Remaining attempts to meet, 0 if no meeting is planned */
+  uint8_t meet_left;
+  /* Moving average of path loss in dB with NBR_RSSI_FRAC_BITS fraction bits,
+   * 0 if unknown, see txpwr.h */
+  uint16_t pathloss;
+  /* Short IDs of neighbors the neighbor gossiped, 0 marks unused slots */
+  uint16_t two_hop[NBR_TWO_HOP];
+} nbr_entry_t;
+
+/**
+ * Initializes neighbor table
+ *
+ * Table is kept in retained RAM and only cleared if it is not valid, i.e.
+ * after a cold boot. Planned meetings are dropped, as the system time restarts
+ * with every boot and nothing retained tells how many slots passed while the
+ * node was off. Meetings therefore only carry over between cycles in which the
+ * node keeps running after the power-fail warning, i.e. when the harvester
+ * supplies at least the sleep current. After a brownout, nodes meet again
+ * once they rediscover each other.
+ *
+ * @returns 0 if retained table was recovered, 1 if it was cleared
+ */
+int nbr_init(void);
+
+/**
+ * Advances table clock by one charging cycle
+ *
+ * Entries age by one cycle. Entries older than NBR_MAX_AGE are treated as
+ * free and overwritten by later inserts.
+ *
+ */
+void nbr_age(void);
+
+/**
+ * Current table clock
+ *
+ * @returns Number of cycles counted since cold boot
+ */
+uint32_t nbr_now(void);
+
+/**
+ * Inserts or refreshes a neighbor
+ *
+ * Searches NBR_PROBE_LEN slots from the hashed position. If the neighbor is
+ * not found, takes the first free or expired slot or evicts the entry that
+ * was heard least recently.
+ *
+ * @param device_id ID of neighbor
+ * @param rssi RSSI of received packet in -dBm
+ * @param t_chr Charging time advertised by neighbor
+ *
+ * @returns Reference to updated entry
+ */
+nbr_entry_t *nbr_update(uint32_t device_id, uint8_t rssi, uint16_t t_chr);
+
+/**
+ * Plans the own next wakeup
+ *
+ * The next wakeup can't be earlier than one charging time after the current
+ * round. If a meeting with a neighbor is planned within another charging time,
+ * the wakeup is aligned to it, so that neighbors converge to common wakeups.
+ * Otherwise, the charging time plus a margin is planned.
+ *
+ * @param now System time of the current discovery round
+ * @param t_chr Own charging time in flync ticks
+ *
+ * @returns Planned wakeup in system time, advertised in discovery rounds
+ */
+uint32_t nbr_plan(uint32_t now, uint16_t t_chr);
+
+/**
+ * Plans a meeting with a neighbor that was heard
+ *
+ * Both sides know both planned wakeups and charging times after a beacon was
+ * acknowledged. They agree on the later wakeup and retry missed meetings in
+ * an interval of the longer charging time plus margin.
+ *
+ * @param entry Neighbor returned by nbr_update
+ * @param t_own Own planned wakeup returned by nbr_plan
+ * @param t_peer Neighbor's planned wakeup in own system time
+ * @param t_chr Own charging time in flync ticks
+ *
+ */
+void nbr_schedule(nbr_entry_t *entry, uint32_t t_own, uint32_t t_peer,
+                  uint16_t t_chr);
+
+/**
+ * Next planned meeting
+ *
+ * Meetings that passed without hearing the neighbor count as missed and are
+ * retried one interval later, up to NBR_MEET_RETRIES times.
+ *
+ * @param now Current system time
+ * @param t_meet Earliest meeting after now in system time
+ *
+ * @returns 0 if a meeting is planned, -1 otherwise
+ */
+int nbr_meeting(uint32_t now, uint32_t *t_meet);
+
+/**
+ * Short ID of a device for gossip
+ *
+ * Folds the device ID to 16 bits. Different devices may share a short ID.
+ *
+ * @param device_id ID of device
+ *
+ * @returns Short ID, never 0
+ */
+uint16_t nbr_short_id(uint32_t device_id);
+
+/**
+ * Short IDs of the most recently heard neighbors
+ *
+ * @param ids Buffer for short IDs, unused slots are set to 0
+ * @param n Size of buffer
+ *
+ * @returns Number of IDs written
+ */
+unsigned int nbr_recent(uint16_t *ids, unsigned int n);
+
+/**
+ * Stores the neighbors gossiped by a neighbor
+ *
+ * Replaces the previously gossiped neighbors. Keeps up to NBR_TWO_HOP short
+ * IDs and skips the own one.
+ *
+ * @param entry Neighbor returned by nbr_update
+ * @param ids Short IDs received from the neighbor, 0 marks unused slots
+ * @param n Number of received short IDs
+ * @param own_id Own device ID
+ *
+ */
+void nbr_gossip(nbr_entry_t *entry, const uint16_t *ids, unsigned int n,
+                uint32_t own_id);
+
+/**
+ * Looks up a neighbor
+ *
+ * @param device_id ID of neighbor
+ *
+ * @returns Reference to entry or NULL if neighbor is unknown or expired
+ */
+nbr_entry_t *nbr_lookup(uint32_t device_id);
+
+/**
+ * Iterates over known neighbors
+ *
+ * @param idx Iterator state, must be initialized to 0
+ *
+ * @returns Next valid entry or NULL after the last one
+ */
+nbr_entry_t *nbr_next(unsigned int *idx);
+
+/**
+ * Number of known neighbors
+ *
+ * @returns Number of entries that have not expired
+ */
+unsigned int nbr_count(void);
+
+#endif /* __NEIGHBOR_H_ */
@@ -1,16 +1,11 @@
 #ifndef __PERIPHERALS_H__
 #define __PERIPHERALS_H__
 
+#include "charge.h"
 #include "pt.h"
 #include <nrf_power.h>
 #include <stdint.h>
 
-#define ADC_GAIN 1 / 6
-#define ADC_REF 0.6
-#define ADC_BITS 10
-
-#define V2ADC(x) (unsigned int)(x * ADC_GAIN / ADC_REF * (1 << ADC_BITS))
-
 extern volatile int16_t adc_result;
 /**
  * Puts CPU to sleep
@@ -61,6 +56,17 @@ volatile pt_event_t *pofwarn_request_evt(nrf_power_pof_thr_t pofwarn_thr);
  */
 int pofwarn_disable(void);
 
+/**
+ * Starts HFCLK and measures its startup latency
+ *
+ * Timestamps the start with the RTC. The POWER_CLOCK interrupt handler
+ * passes the RTC ticks until HFCLKSTARTED to hfclk_update. Nothing is
+ * measured if HFCLK is already running.
+ *
+ * @returns 0 on success
+ */
+int hfclk_start(void);
+
 /**
  * Initializes watchdog timer
  *
@@ -88,9 +94,10 @@ int wdt_reload(void);
  *
  * Sets up ADC peripheral to take a sample of the supply (capacitor) voltage
  * with every compare match of the RTC peripheral that is synchronized to the
- * external flync clock signal. Configures ADC to fire interrupt when result
- * is available. This interrupt plays a crucial role in the flync core
- * implementation.
+ * external flync clock signal. Without FLYNC_HW_CAPTURE, configures ADC to
+ * fire interrupt when result is available. This interrupt then plays a
+ * crucial role in the flync core implementation. Otherwise, the CPU is only
+ * woken up by the charge monitor on threshold crossings.
  *
  * @returns 0 on success
  */
@@ -0,0 +1,156 @@
+#ifndef __PLL_H_
+#define __PLL_H_
+
+#include <stdint.h>
+
+/* Fraction bits of period and phase estimates */
+#define PLL_FRAC_BITS 8
+
+/* RTC frequency the flicker period is measured with */
+#define PLL_RTC_FREQUENCY 32768UL
+/* Periods deviating by less than 1/2^PLL_FREQ_TOL_SHIFT from the estimate or
+ * from the nominal period of a flicker rate are plausible. Rates are 20%
+ * apart and the RTC tolerance is far below this. */
+#define PLL_FREQ_TOL_SHIFT 5
+
+/* Frequency gain starts at 1 and decays to 1/PLL_FLL_GAIN_MAX */
+#define PLL_FLL_GAIN_MAX 16
+/* Frequency samples spanning more periods than this are discarded */
+#define PLL_FLL_MAX_SPAN 64
+/* After this many consecutive implausible frequency samples, the estimate is
+ * discarded and the frequency re-acquired with full gain */
+#define PLL_FLL_REACQUIRE 8
+/* Fraction 1/PLL_PHASE_GAIN of phase error is corrected per update */
+#define PLL_PHASE_GAIN 4
+
+/* Phase error in RTC ticks below which the PLL is considered locked */
+#define PLL_LOCK_THR 2
+/* Number of consecutive locked updates before decimation is doubled */
+#define PLL_LOCK_UPDATES 16
+
+/* While locked, edges with larger phase error in RTC ticks are outliers */
+#define PLL_OUTLIER_THR 16
+/* After this many consecutive rejected edges, the PLL accepts them to relock */
+#define PLL_RELOCK_EDGES 8
+
+/* At least this many missing edges are considered an MPPT gap */
+#define PLL_GAP_MIN 4
+/* Number of gaps matching the learned interval before gaps are predicted */
+#define PLL_GAP_HITS 2
+/* Margin around predicted gaps in flync periods */
+#define PLL_GAP_MARGIN 2
+
+typedef struct {
+  /* Estimated flicker period in RTC ticks with PLL_FRAC_BITS fraction bits */
+  int32_t freq;
+  /* Residual of rounding the period to whole RTC ticks */
+  int32_t frac;
+  /* Period register value set by the last update */
+  unsigned int period;
+  /* Phase of the previous edge, 0 if there is none to compare against */
+  unsigned int phase_prev;
+  /* Number of frequency samples, sets the frequency gain */
+  unsigned int n_fll;
+  /* Number of consecutive implausible frequency samples */
+  unsigned int n_fll_gated;
+
+  /* Number of flync periods until the next update */
+  unsigned int decim;
+  /* Upper bound for decimation */
+  unsigned int decim_max;
+  /* Number of consecutive updates within lock threshold */
+  unsigned int n_locked;
+  /* Number of consecutive rejected edges */
+  unsigned int n_rejected;
+
+  /* Flync tick at which the last MPPT gap started */
+  uint32_t gap_last;
+  /* Learned interval between MPPT gaps in flync periods */
+  uint32_t gap_interval;
+  /* Learned length of MPPT gaps in flync periods */
+  uint32_t gap_len;
+  /* Number of consecutive gaps matching the learned interval */
+  unsigned int gap_hits;
+} pll_t;
+
+/**
+ * Initializes PLL
+ *
+ * @param pll PLL state
+ * @param period Measured or restored flync period in RTC ticks
+ * @param freq Period estimate from before a brownout with PLL_FRAC_BITS
+ * fraction bits. Provide 0 to start from period with full gain. Estimates
+ * that match no flicker rate are discarded like 0.
+ * @param decim_max Maximum number of periods between two updates. Provide 1
+ * to update on every edge.
+ *
+ */
+void pll_init(pll_t *pll, unsigned int period, int32_t freq,
+              unsigned int decim_max);
+
+/**
+ * Updates PLL with a measured phase
+ *
+ * Edges outside the middle half of the period and, while locked, edges with
+ * a phase error above PLL_OUTLIER_THR are rejected as spurious. Only after
+ * PLL_RELOCK_EDGES consecutive rejections, the PLL follows them.
+ *
+ * Estimates frequency and phase separately. The drift of the phase between
+ * two updates gives a sample of the flicker period, which is averaged with a
+ * gain that decays from one to 1/PLL_FLL_GAIN_MAX, so that the PLL locks
+ * within few edges. Samples off the estimate by more than the tolerance are
+ * ignored, unless PLL_FLL_REACQUIRE of them follow each other, e.g. after a
+ * brownout with a stale estimate. Then the frequency is acquired anew. A
+ * fraction of the phase error with respect to half the period is corrected on
+ * top of the estimated period.
+ *
+ * Once the phase error stays below the lock threshold for PLL_LOCK_UPDATES
+ * updates, the number of periods between updates is doubled up to
+ * decim_max. Periods without an edge are counted as MPPT gap to learn when
+ * the next gap will happen.
+ *
+ * @param pll PLL state
+ * @param phase RTC counter value at flicker edge
+ * @param n_periods Number of flync periods since last accepted edge
+ * @param n_edges Number of edges counted since last accepted edge
+ * @param now Current system time in flync ticks
+ *
+ * @returns New value of the period register in RTC ticks or 0 if the edge was
+ * rejected
+ */
+unsigned int pll_update(pll_t *pll, unsigned int phase, unsigned int n_periods,
+                        unsigned int n_edges, uint32_t now);
+
+/**
+ * Matches a flicker period to a flicker rate
+ *
+ * @param freq Period in RTC ticks with PLL_FRAC_BITS fraction bits
+ *
+ * @returns Flicker rate in Hz whose nominal period is within the tolerance of
+ * PLL_FREQ_TOL_SHIFT, 0 if there is none
+ */
+unsigned int pll_rate(int32_t freq);
+
+/**
+ * Checks for a predicted MPPT gap
+ *
+ * @param pll PLL state
+ * @param now Current system time in flync ticks
+ *
+ * @returns 1 if edges are expected to be missing or spurious, 0 otherwise
+ */
+int pll_holdover(const pll_t *pll, uint32_t now);
+
+/**
+ * Free-runs on estimated frequency
+ *
+ * Must be called once per period without edge. Dithers between whole RTC
+ * ticks, so that the average period matches the estimated period.
+ *
+ * @param pll PLL state
+ *
+ * @returns New value of the period register in RTC ticks
+ */
+unsigned int pll_freerun(pll_t *pll);
+
+#endif /* __PLL_H_ */
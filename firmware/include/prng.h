@@ -11,6 +11,24 @@
  */
 void prng_seed();
 
+/*
+ * Restores state of the pseudo random number generator.
+ *
+ * Continues the sequence from a previously saved state instead of seeding.
+ *
+ * @param state Four words of generator state
+ *
+ */
+void prng_restore(const uint32_t *state);
+
+/*
+ * Saves state of the pseudo random number generator.
+ *
+ * @param state Buffer for four words of generator state
+ *
+ */
+void prng_save(uint32_t *state);
+
 /*
  * Samples uniform random variable.
  *
@@ -25,20 +43,36 @@ void prng_seed();
  */
 uint32_t prng_urand(uint32_t min, uint32_t max);
 
+/* Layout of the scale LUT, must match gen_scale_lut.py */
+#define LUT_TCHR_STEP 10
+#define LUT_TCHR_LEN 256
+#define LUT_DENSITY_MIN 2
+#define LUT_DENSITY_STEP 2
+#define LUT_DENSITY_LEN 16
+
+/* Densities are passed as number of nodes in fixed point with 8 fraction bits */
+#define LUT_DENSITY_FRAC_BITS 8
+/* Density for which the original two-node table was optimized */
+#define LUT_DENSITY_DEFAULT (2 << LUT_DENSITY_FRAC_BITS)
+
 /*
  *
  * Looks up distribution 'scale' from a table in NVM
  *
  * The exact shape of the optimized waiting distribution depends on the
- * charging times of the node. We precalculate optimized scales for different
- * waiting times and store them in a LUT.
+ * charging times of the node and on the number of nodes contending for the
+ * same slots. We precalculate optimized scales on a grid of charging times
+ * and densities, store them in a LUT and interpolate bilinearly in fixed
+ * point.
  *
- * @param t_chr Current waiting time in flync ticks (10ms)
+ * @param t_chr Current charging time in flync ticks
+ * @param density Estimated number of nodes in the clique in fixed point with
+ * LUT_DENSITY_FRAC_BITS fraction bits
  *
  * @returns Scale parameter of optimized geometric distribution
  *
  */
-float lookup_scale(unsigned int t_chr);
+float lookup_scale(unsigned int t_chr, unsigned int density);
 
 /*
  * Samples geometric distribution using inverse transform sampling
@@ -172,35 +172,73 @@ struct pt
                         else                 \
                             _pt_line(body) :
 
+/*
+ * Atomic accessors for state shared between interrupt handlers and threads.
+ * Stores release all prior writes, loads acquire all writes released before.
+ */
+#define _pt_load(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define _pt_store(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+
 /*
  * Queues
+ *
+ * Lock-free single-producer/single-consumer ring buffer. Push, or tail and
+ * commit, may be called from one context, e.g. an interrupt handler, while
+ * peek, drop and pop are called from another one. Size must be a power of
+ * two. Indices run freely and are masked on access.
  */
-#define pt_queue(T, size) \
-    struct                \
-    {                     \
-        T buf[size];      \
-        unsigned int r;   \
-        unsigned int w;   \
+#define pt_queue(T, size)                                                  \
+    struct                                                                 \
+    {                                                                      \
+        _Static_assert(((size) & ((size) - 1)) == 0,                       \
+                       "pt_queue size must be a power of two");            \
+        T buf[size];                                                       \
+        unsigned int r;                                                    \
+        unsigned int w;                                                    \
     }
 #define pt_queue_init() \
     {                   \
         .r = 0, .w = 0  \
     }
 #define pt_queue_len(q) (sizeof((q)->buf) / sizeof((q)->buf[0]))
-#define pt_queue_cap(q) ((q)->w - (q)->r)
-#define pt_queue_empty(q) ((q)->w == (q)->r)
+#define pt_queue_mask(q) (pt_queue_len(q) - 1)
+#define pt_queue_cap(q) (_pt_load((q)->w) - _pt_load((q)->r))
+#define pt_queue_empty(q) (pt_queue_cap(q) == 0)
 #define pt_queue_full(q) (pt_queue_cap(q) == pt_queue_len(q))
+/* Only safe while neither side accesses the queue */
 #define pt_queue_reset(q) ((q)->w = (q)->r = 0)
 
-#define pt_queue_push(q, el) \
-    (!pt_queue_full(q) && ((q)->buf[(q)->w++ % pt_queue_len(q)] = (el), 1))
+/* Producer: copies the element before publishing it to the consumer */
+#define pt_queue_push(q, el)                                    \
+    (!pt_queue_full(q) &&                                       \
+     ((q)->buf[(q)->w & pt_queue_mask(q)] = (el),               \
+      _pt_store((q)->w, (q)->w + 1), 1))
+/* Producer: free slot to be filled in place, e.g. by DMA, NULL if full */
+#define pt_queue_tail(q) \
+    (pt_queue_full(q) ? NULL : &(q)->buf[(q)->w & pt_queue_mask(q)])
+/* Producer: publishes the slot returned by tail to the consumer */
+#define pt_queue_commit(q) _pt_store((q)->w, (q)->w + 1)
+/* Consumer: oldest element, stays valid until it is dropped */
 #define pt_queue_peek(q) \
-    (pt_queue_empty(q) ? NULL : &(q)->buf[(q)->r % pt_queue_len(q)])
-#define pt_queue_pop(q) \
-    (pt_queue_empty(q) ? NULL : &(q)->buf[(q)->r++ % pt_queue_len(q)])
+    (pt_queue_empty(q) ? NULL : &(q)->buf[(q)->r & pt_queue_mask(q)])
+/* Consumer: hands the slot of the oldest element back to the producer */
+#define pt_queue_drop(q) _pt_store((q)->r, (q)->r + 1)
+/*
+ * Consumer: removes the oldest element, which may be overwritten by the next
+ * push. Use peek and drop if the producer runs in another context.
+ */
+#define pt_queue_pop(q)                                                   \
+    (pt_queue_empty(q)                                                    \
+         ? NULL                                                           \
+         : &(q)->buf[__atomic_fetch_add(&(q)->r, 1, __ATOMIC_RELEASE) &   \
+                     pt_queue_mask(q)])
 
 /*
  * Events
+ *
+ * Can be set from interrupt handlers and waited on from threads. Waiting
+ * consumes the event atomically, so that a set racing with the wait is
+ * not lost.
  */
 
 #define pt_event() \
@@ -212,12 +250,12 @@ struct pt
     {                   \
         .s = 0          \
     }
-#define pt_event_get(e) (e)->s
-#define pt_event_set(e) (e)->s = 1
-#define pt_event_clear(e) (e)->s = 0
-#define pt_event_wait(pt, e)  \
-    pt_wait(pt, (e)->s == 1); \
-    (e)->s = 0
+#define pt_event_get(e) _pt_load((e)->s)
+#define pt_event_set(e) _pt_store((e)->s, 1)
+#define pt_event_clear(e) _pt_store((e)->s, 0)
+/* Returns the state of the event and clears it in one step */
+#define pt_event_take(e) __atomic_exchange_n(&(e)->s, 0, __ATOMIC_ACQUIRE)
+#define pt_event_wait(pt, e) pt_wait(pt, pt_event_take(e))
 
 #define pt_wait_hwevent(pt, evt) \
     evt = 0;                     \
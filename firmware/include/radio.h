@@ -6,6 +6,46 @@
 
 #define RADIO_NO_GPIO 32
 
+/* Radio profiles, i.e. PHY and packet format of beacons and acknowledgements */
+enum RadioProfile {
+  /* BLE 1Mbit, 8-bit preamble, 3-byte address, 1-byte CRC */
+  RADIO_PROFILE_1M = 0,
+  /* BLE 2Mbit, 8-bit preamble, 3-byte address, 1-byte CRC */
+  RADIO_PROFILE_2M = 1,
+  /* BLE Coded PHY with S=2, i.e. 500kbit, 4-byte address, 3-byte CRC */
+  RADIO_PROFILE_CODED_S2 = 2,
+  /* BLE Coded PHY with S=8, i.e. 125kbit, 4-byte address, 3-byte CRC */
+  RADIO_PROFILE_CODED_S8 = 3,
+  RADIO_N_PROFILES = 4
+};
+
+/* Profile selected by radio_init, can be changed with radio_set_profile */
+#ifndef RADIO_PROFILE
+#define RADIO_PROFILE RADIO_PROFILE_2M
+#endif
+
+typedef struct {
+  /* Value of MODE register */
+  uint8_t mode;
+  /* Preamble, coding indicator and TERM1 lengths in PCNF0 */
+  uint8_t plen;
+  uint8_t cilen;
+  uint8_t termlen;
+  /* Length of base address in bytes, the prefix adds another byte */
+  uint8_t balen;
+  /* Length of CRC in bytes, polynomial and initial value */
+  uint8_t crc_len;
+  uint32_t crc_poly;
+  uint32_t crc_init;
+  /* Interframe spacing of the TX/RX turnaround in us */
+  uint8_t tifs_us;
+  /* Airtime of preamble and address, and of the coded TERM2 field in us */
+  uint16_t head_us;
+  uint8_t tail_us;
+  /* Airtime of a byte of payload or CRC in us */
+  uint8_t byte_us;
+} radio_profile_t;
+
 enum RadioLogicalAddress {
   /* Heading beacon logical address */
   LA_BCN = 1,
@@ -18,11 +58,63 @@ enum RadioLogicalAddress {
 /**
  * Initializes radio peripheral
  *
+ * Configures the radio for RADIO_PROFILE.
+ *
  * @param gpio_pin Pin used for debug. Provide RADIO_NO_GPIO to disable.
+ * @param payload_len Length of the static payload in bytes
  *
  * @returns 0 on success
  */
-int radio_init(unsigned int gpio_pin);
+int radio_init(unsigned int gpio_pin, unsigned int payload_len);
+
+/**
+ * Switches PHY and packet format
+ *
+ * Must only be called while the radio is disabled, i.e. between discovery
+ * rounds. Both peers of a link must use the same profile.
+ *
+ * @param profile Radio profile
+ *
+ * @returns 0 on success, -1 if the profile is unknown
+ */
+int radio_set_profile(enum RadioProfile profile);
+
+/**
+ * Returns selected radio profile
+ *
+ * @returns Reference to the parameters of the selected profile
+ */
+const radio_profile_t *radio_profile(void);
+
+/**
+ * Airtime of a packet with the selected profile
+ *
+ * @returns Time from the first bit of the preamble to the last bit of the
+ * packet in us
+ */
+unsigned int radio_airtime_us(void);
+
+/**
+ * Airtime of a packet with the selected profile in RTC ticks
+ *
+ * @returns Airtime rounded up to full RTC ticks
+ */
+unsigned int radio_airtime_tcks(void);
+
+/**
+ * Sets TX power of beacons and acknowledgements
+ *
+ * @param dbm TX power in dBm, must be supported by the radio
+ *
+ */
+void radio_set_txpower(int dbm);
+
+/**
+ * Current TX power
+ *
+ * @returns TX power in dBm
+ */
+int radio_txpower(void);
 
 /**
  * Enables radio event
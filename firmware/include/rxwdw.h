@@ -0,0 +1,22 @@
+#ifndef __RXWDW_H_
+#define __RXWDW_H_
+
+#include "rxwdw_lut.h"
+
+/**
+ * Selects RX window margin from the capacitor voltage
+ *
+ * Looks up the margin that maximizes the expected number of rendezvous with
+ * the energy stored above RXWDW_LUT_V_MIN, including the following rounds.
+ * The table is generated by gen_rxwdw_lut.py from the energy model in
+ * ../model. Headroom that doesn't suffice for another round is spent on a
+ * longer window.
+ *
+ * @param v_adc Capacitor voltage in binary ADC code
+ * @param min_tcks Margin if not even one full round fits
+ *
+ * @returns RX window margin in RTC ticks
+ */
+unsigned int rxwdw_select(unsigned int v_adc, unsigned int min_tcks);
+
+#endif /* __RXWDW_H_ */
@@ -0,0 +1,16 @@
+#ifndef __RXWDW_LUT_H_
+#define __RXWDW_LUT_H_
+
+/* Generated by gen_rxwdw_lut.py with sigma 4.0 and p_sync 0.8 */
+
+/* Voltage of the first entry and between entries */
+#define RXWDW_LUT_V_MIN 3.0
+#define RXWDW_LUT_V_STEP 0.025
+#define RXWDW_LUT_LEN 21
+
+/* RX window margin in RTC ticks, 0 if no full round fits */
+#define RXWDW_LUT                                                              \
+  { 0, 0, 0, 0, 0, 0, 22, 30, 36, 42, 48, 56, 24, 28, 30, 30, 30, 22, 24, 26,  \
+  30 }
+
+#endif /* __RXWDW_LUT_H_ */
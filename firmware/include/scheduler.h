@@ -0,0 +1,83 @@
+#ifndef __SCHEDULER_H_
+#define __SCHEDULER_H_
+
+#include <stdint.h>
+
+#include "pt.h"
+
+/* Maximum number of protothreads */
+#define SCHED_MAX_THREADS 8
+
+/* Sources of events that threads can wait on */
+#define SCHED_EVT_TIMER (1UL << 0)
+#define SCHED_EVT_CHARGE (1UL << 1)
+#define SCHED_EVT_RADIO (1UL << 2)
+#define SCHED_EVT_POFWARN (1UL << 3)
+/* Thread is resumed on any event */
+#define SCHED_EVT_ANY 0xFFFFFFFFUL
+
+typedef void (*sched_fn_t)(struct pt *pt);
+
+/**
+ * Waits until condition is true, resuming only on the given events
+ *
+ * The condition is only evaluated when one of the events was notified since
+ * the thread last ran. The event mask stays in effect until the thread
+ * declares a new one.
+ *
+ * @param pt Handle of protothread
+ * @param events Bitmask of SCHED_EVT_* that can make the condition true
+ * @param cond Condition to wait for
+ *
+ */
+#define sched_wait(pt, events, cond)                                           \
+  do {                                                                         \
+    sched_block(events);                                                       \
+    pt_wait(pt, cond);                                                         \
+  } while (0)
+
+/**
+ * Adds a protothread to the scheduler
+ *
+ * Threads run once when the scheduler starts and then wait on SCHED_EVT_ANY,
+ * until they declare their events.
+ *
+ * @param fn Protothread function
+ *
+ * @returns 0 on success, -1 if SCHED_MAX_THREADS are already added
+ */
+int sched_add(sched_fn_t fn);
+
+/**
+ * Sets events on which the running thread is resumed
+ *
+ * Must be called from a thread before it blocks. Use sched_wait to wait on a
+ * condition.
+ *
+ * @param events Bitmask of SCHED_EVT_*
+ *
+ */
+void sched_block(uint32_t events);
+
+/**
+ * Marks threads waiting on any of the events ready
+ *
+ * Safe to call from interrupt handlers at any priority. Prevents the CPU from
+ * going to sleep before the scheduler has resumed the threads.
+ *
+ * @param events Bitmask of SCHED_EVT_*
+ *
+ */
+void sched_notify(uint32_t events);
+
+/**
+ * Runs threads
+ *
+ * Resumes every thread that waits on one of the events notified since its
+ * last run, in the order they were added. Sleeps when no thread is ready.
+ * Never returns.
+ *
+ */
+void sched_run(void);
+
+#endif /* __SCHEDULER_H_ */
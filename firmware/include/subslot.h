@@ -0,0 +1,102 @@
+#ifndef __SUBSLOT_H_
+#define __SUBSLOT_H_
+
+/* Number of beacon sub-slots of a round, 1 to beacon at the start time.
+ * Nodes active in the same slot only collide if they pick the same sub-slot
+ * (../model/examples/compare_subslots.py). Fewer are used if they don't fit
+ * into the flync period. */
+#define DISCO_SUBSLOTS 4
+
+/* Spacing of sub-slots in RTC ticks on top of a beacon, the turnaround and
+ * an acknowledgement, covers the phase error between synchronized nodes */
+#define DISCO_SUBSLOT_GUARD_TCKS 4
+
+/* Pick the sub-slot by hashing the device ID instead of at random in every
+ * round */
+#define DISCO_SUBSLOT_BY_ID 0
+
+/* Beacon is sent this many RTC ticks after the given start time */
+#define DISCO_TX_DELAY_TCKS 20
+
+/**
+ * Spacing of beacon sub-slots
+ *
+ * A sub-slot holds a beacon, the turnaround of a listener and its
+ * acknowledgement, so that the acknowledgement doesn't overlap the beacon of
+ * the next sub-slot.
+ *
+ * @param airtime_us Airtime of a packet in the radio profile in us
+ * @param tifs_us Interframe spacing of the radio profile in us
+ *
+ * @returns Spacing in RTC ticks, including DISCO_SUBSLOT_GUARD_TCKS
+ */
+unsigned int subslot_spacing(unsigned int airtime_us, unsigned int tifs_us);
+
+/**
+ * Number of sub-slots that fit into the flync period
+ *
+ * Beacons of all sub-slots must go out before the end of the period, so that
+ * they stay on the phase that synchronized nodes expect.
+ *
+ * @param period_tcks Flync period in RTC ticks
+ * @param start_tcks Start time of the round within the period in RTC ticks
+ * @param spacing_tcks Spacing of sub-slots in RTC ticks
+ *
+ * @returns Number of usable sub-slots, at most DISCO_SUBSLOTS and at least 1
+ */
+unsigned int subslot_count(unsigned int period_tcks, unsigned int start_tcks,
+                           unsigned int spacing_tcks);
+
+/**
+ * Beacon time of a sub-slot
+ *
+ * @param start_tcks Start time of the round within the period in RTC ticks
+ * @param subslot Index of the sub-slot
+ * @param spacing_tcks Spacing of sub-slots in RTC ticks
+ *
+ * @returns RTC counter value at which the beacon is sent
+ */
+unsigned int subslot_beacon(unsigned int start_tcks, unsigned int subslot,
+                            unsigned int spacing_tcks);
+
+/**
+ * First sub-slot that leaves room to start HFCLK
+ *
+ * The crystal must be started the given lead ahead of the beacon. If the
+ * counter already passed that point for the picked sub-slot, e.g. because
+ * the round started late, the beacon moves to the next sub-slot that still
+ * leaves room.
+ *
+ * @param now_tcks Current RTC counter value
+ * @param lead_tcks HFCLK lead in RTC ticks
+ * @param start_tcks Start time of the round within the period in RTC ticks
+ * @param subslot Index of the picked sub-slot
+ * @param n_subslots Number of usable sub-slots
+ * @param spacing_tcks Spacing of sub-slots in RTC ticks
+ *
+ * @returns Index of the sub-slot or n_subslots if none leaves room, then the
+ * round must be skipped
+ */
+unsigned int subslot_reachable(unsigned int now_tcks, unsigned int lead_tcks,
+                               unsigned int start_tcks, unsigned int subslot,
+                               unsigned int n_subslots,
+                               unsigned int spacing_tcks);
+
+/**
+ * Margin of the RX window after the beacon of a sub-slot
+ *
+ * The window extends up to the beacon of the last usable sub-slot if the
+ * given margin is shorter, so that nodes hear all later sub-slots.
+ *
+ * @param n_subslots Number of usable sub-slots
+ * @param subslot Index of the own sub-slot
+ * @param spacing_tcks Spacing of sub-slots in RTC ticks
+ * @param rx_wdw_tcks Margin of the RX window in RTC ticks
+ *
+ * @returns Margin in RTC ticks on top of the airtime of two packets
+ */
+unsigned int subslot_window(unsigned int n_subslots, unsigned int subslot,
+                            unsigned int spacing_tcks,
+                            unsigned int rx_wdw_tcks);
+
+#endif /* __SUBSLOT_H_ */
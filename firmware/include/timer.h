@@ -1,6 +1,22 @@
 #ifndef __TIMER_H_
 #define __TIMER_H_
 #include "pt.h"
+#include "timerq.h"
+
+/**
+ * Initializes system timer
+ *
+ * With FLYNC_HW_CAPTURE, flync clock periods are counted by TIMER3 via PPI,
+ * so that the CPU does not have to wake up on every clock edge. Otherwise,
+ * system time is advanced by _timer_tick.
+ *
+ * Any number of software timers up to TIMERQ_LEN can be pending. They are
+ * kept in a queue ordered by deadline and only the earliest one is armed: on
+ * TIMER3 until its flync period starts, then on RTC0 CC[2].
+ *
+ * @returns 0 on success
+ */
+int timer_init(void);
 
 /**
  * Current system time in flync ticks
@@ -12,6 +28,9 @@
  */
 unsigned int timer_now(void);
 
+/* Software timer, owned by the caller. Zero-initialized timers are idle. */
+typedef timerq_entry_t timer_handle_t;
+
 /**
  * Sets an RTC timer by wait time
  *
@@ -19,31 +38,30 @@ unsigned int timer_now(void);
  * timer. The timer is reset on every rising edge of the flync clock. Timer
  * is fired only once.
  *
+ * @param timer Timer owned by the caller
  * @param wait_ticks Number of RTC ticks before event is triggered
  *
- * @returns Event that is set after specified wait time
+ * @returns Event that is set after specified wait time or NULL if too many
+ * timers are pending
  */
-volatile pt_event_t *timer_rtc_wait(unsigned int wait_ticks);
+volatile pt_event_t *timer_rtc_wait(timer_handle_t *timer,
+                                    unsigned int wait_ticks);
 /**
  * Sets an RTC timer
  *
  * Allows to setup a timer with respect to the PLL-disciplined 32kHz RTC
- * timer. The timer is reset on every rising edge of the flync clock. Timer
- * is fired only once.
+ * timer. The RTC is reset on every rising edge of the flync clock. Values
+ * beyond the current flync period are carried over into the following
+ * periods. Timer is fired only once.
  *
- * @param rtc_ticks Timer timeout in RTC ticks
+ * @param timer Timer owned by the caller
+ * @param rtc_ticks Timer timeout in RTC ticks after start of current period
  *
- * @returns Event that is set at specified time on RTC
+ * @returns Event that is set at specified time on RTC or NULL if too many
+ * timers are pending
  */
-volatile pt_event_t *timer_rtc_set(unsigned int rtc_ticks);
-
-/**
- * Cancels RTC timer
- *
- * Cancels a previously set RTC timer so that it can be set again.
- *
- */
-int timer_rtc_cancel(void);
+volatile pt_event_t *timer_rtc_set(timer_handle_t *timer,
+                                   unsigned int rtc_ticks);
 
 /**
  * Sets a flync timer by wait time
@@ -52,11 +70,14 @@ int timer_rtc_cancel(void);
  * fire after specified number of flync clock edges. Setting wait_time to zero
  * triggers event at next clock edge.
  *
+ * @param timer Timer owned by the caller
  * @param wait_time Number of clock edges to wait before event is triggered
  *
- * @returns Event that is set after specified wait time
+ * @returns Event that is set after specified wait time or NULL if too many
+ * timers are pending
  */
-volatile pt_event_t *timer_flync_wait(unsigned int wait_time);
+volatile pt_event_t *timer_flync_wait(timer_handle_t *timer,
+                                      unsigned int wait_time);
 
 /**
  * Sets a flync timer by absolute time
@@ -64,25 +85,32 @@ volatile pt_event_t *timer_flync_wait(unsigned int wait_time);
  * Allows to setup a timer with respect to the flync clock. Timer is set to
  * fire on the rising edge when the system time reaches the specified time.
  *
- * @param wait_time Time at which event should be triggered
+ * @param timer Timer owned by the caller
+ * @param time Time at which event should be triggered
  *
- * @returns Event that is set at specified time
+ * @returns Event that is set at specified time or NULL if the time is in the
+ * past or too many timers are pending
  */
-volatile pt_event_t *timer_flync_set(unsigned int time);
+volatile pt_event_t *timer_flync_set(timer_handle_t *timer, unsigned int time);
 
 /**
- * Cancels flync timer
+ * Cancels a timer
+ *
+ * Cancels a previously set RTC or flync timer. Other pending timers are not
+ * affected.
  *
- * Cancels a previously set flync timer so that it can be set again.
+ * @param timer Timer owned by the caller
  *
+ * @returns 0 on success, -1 if the timer was not pending
  */
-int timer_flync_cancel(void);
+int timer_cancel(timer_handle_t *timer);
 
 /**
  * Increments the system time
  *
- * Must be called externally at every flync clock edge. Increments the
- * internal counter and checks if the flync timer has expired.
+ * Must be called externally at every flync clock edge, unless the edges are
+ * counted in hardware. Increments the internal counter and dispatches
+ * expired timers.
  *
  */
 void _timer_tick(void);
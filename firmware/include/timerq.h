@@ -0,0 +1,114 @@
+#ifndef __TIMERQ_H_
+#define __TIMERQ_H_
+
+#include <stdint.h>
+
+#include "pt.h"
+
+/* Maximum number of pending timers */
+#define TIMERQ_LEN 8
+
+/* Queue position of timers that are not pending */
+#define TIMERQ_IDLE TIMERQ_LEN
+
+/*
+ * Deadline of a software timer
+ *
+ * The RTC is cleared at the end of every flync period, so RTC ticks are only
+ * meaningful together with the flync tick in which they are counted. Flync
+ * timers expire at RTC tick 0 of their flync tick. Zero-initialized entries
+ * are not pending.
+ */
+typedef struct {
+  /* Flync tick in which the timer expires */
+  uint32_t tick;
+  /* RTC ticks after the start of that flync tick */
+  uint32_t rtc;
+  /* Position in the queue or TIMERQ_IDLE */
+  unsigned int idx;
+  /* Set once the timer has expired */
+  volatile pt_event_t evt;
+} timerq_entry_t;
+
+/* Binary min-heap of pending timers ordered by deadline */
+typedef struct {
+  timerq_entry_t *heap[TIMERQ_LEN];
+  unsigned int n;
+} timerq_t;
+
+/**
+ * Initializes empty timer queue
+ *
+ * @param q Timer queue
+ *
+ */
+void timerq_init(timerq_t *q);
+
+/**
+ * Moves RTC ticks that exceed the flync period into the following periods
+ *
+ * @param tick Flync tick of deadline, incremented for every full period
+ * @param rtc RTC ticks after start of tick, reduced to less than period
+ * @param period Flync period in RTC ticks
+ *
+ */
+void timerq_normalize(uint32_t *tick, uint32_t *rtc, unsigned int period);
+
+/**
+ * Compares two deadlines
+ *
+ * Flync ticks are compared by their difference, so that the order is correct
+ * across wraparound of the 32-bit system time.
+ *
+ * @returns 1 if deadline a is before deadline b, 0 otherwise
+ */
+int timerq_before(uint32_t a_tick, uint32_t a_rtc, uint32_t b_tick,
+                  uint32_t b_rtc);
+
+/**
+ * Adds a timer to the queue
+ *
+ * A timer that is already pending is moved to its new deadline. Clears the
+ * event of the timer.
+ *
+ * @param q Timer queue
+ * @param e Timer with deadline set
+ *
+ * @returns 0 on success, -1 if the queue is full
+ */
+int timerq_insert(timerq_t *q, timerq_entry_t *e);
+
+/**
+ * Removes a pending timer from the queue
+ *
+ * @param q Timer queue
+ * @param e Timer to remove
+ *
+ * @returns 0 on success, -1 if the timer was not pending
+ */
+int timerq_remove(timerq_t *q, timerq_entry_t *e);
+
+/**
+ * Returns the timer with the earliest deadline
+ *
+ * @param q Timer queue
+ *
+ * @returns Earliest timer or NULL if the queue is empty
+ */
+timerq_entry_t *timerq_peek(const timerq_t *q);
+
+/**
+ * Removes the earliest timer if it has expired
+ *
+ * Must be called repeatedly until it returns NULL to dispatch all expired
+ * timers. Each call takes O(log n).
+ *
+ * @param q Timer queue
+ * @param tick Current flync tick
+ * @param rtc Current RTC ticks after start of flync tick
+ *
+ * @returns Expired timer or NULL if the earliest deadline is in the future
+ */
+timerq_entry_t *timerq_expire(timerq_t *q, uint32_t tick, uint32_t rtc);
+
+#endif /* __TIMERQ_H_ */
@@ -0,0 +1,122 @@
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+#include <stdint.h>
+
+/* Set to 1 to compile in the trace points, host builds always trace */
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 0
+#endif
+
+/* Number of records in the trace ring, must be a power of two */
+#define TRACE_BUF_LEN 256
+
+/* Marks a valid trace ring in retained RAM */
+#define TRACE_MAGIC 0x54524332UL
+
+/* Set in the ID of the trace point that closes a phase */
+#define TRACE_END 0x80
+
+/*
+ * Traced phases, IDs must match PHASES in trace_decode.py. Every phase is
+ * opened by trace_begin and closed by trace_end. TRACE_BOOT is recorded by
+ * trace_init and separates the records of consecutive resets, as the cycle
+ * counter restarts from zero.
+ */
+enum TracePhase {
+  TRACE_BOOT = 0,
+  TRACE_BEACON_PREP = 1,
+  TRACE_TURNAROUND = 2,
+  TRACE_HANDLE_PKT = 3,
+  TRACE_EDGE_IRQ = 4,
+  TRACE_ITF_SAMPLE = 5,
+  TRACE_PLL_UPDATE = 6,
+};
+
+/*
+ * Trace record: cycle counter and RTC counter at the trace point. The RTC
+ * keeps counting while the CPU sleeps and the cycle counter doesn't, so the
+ * decoder uses the RTC for phases that include sleep.
+ */
+typedef struct {
+  uint32_t cycles;
+  /* Trace point ID in bits 24-31, RTC counter in bits 0-23 */
+  uint32_t id_rtc;
+} trace_rec_t;
+
+/* Ring of the most recent records, kept across resets */
+typedef struct {
+  uint32_t magic;
+  /* Free running record index, masked on access */
+  uint32_t w;
+  /* Flync period in RTC ticks, at which the RTC is cleared, 0 if unknown */
+  uint32_t rtc_period;
+  trace_rec_t rec[TRACE_BUF_LEN];
+} trace_buf_t;
+
+#if TRACE_ENABLED
+#define trace_begin(phase) _trace_point(phase)
+#define trace_end(phase) _trace_point((phase) | TRACE_END)
+#else
+#define trace_begin(phase)                                                     \
+  do {                                                                         \
+  } while (0)
+#define trace_end(phase)                                                       \
+  do {                                                                         \
+  } while (0)
+#endif
+
+/**
+ * Enables the cycle counter and records a boot marker
+ *
+ * Records of previous resets are kept, unless the ring in retained RAM is
+ * invalid, e.g. after a power-on reset.
+ *
+ */
+void trace_init(void);
+
+/**
+ * Records the flync period for the decoder
+ *
+ * Phases that cross the end of a flync period are corrected for the RTC
+ * being cleared, so the decoder needs the period. Call after the flicker
+ * rate is known.
+ *
+ * @param rtc_ticks Flync period in RTC ticks
+ *
+ */
+void trace_period(unsigned int rtc_ticks);
+
+/**
+ * Returns the trace ring for readout
+ *
+ * On the node, the ring is best dumped with a debugger at the address of
+ * trace_buf in the linker map and decoded with trace_decode.py.
+ *
+ * @returns Pointer to the trace ring
+ */
+const trace_buf_t *trace_get(void);
+
+#ifdef TRACE_HOST
+/**
+ * Sets the virtual clock that host builds record instead of DWT and RTC
+ *
+ * @param cycles Virtual CPU cycles
+ * @param rtc Virtual RTC counter
+ *
+ */
+void trace_host_clock(uint32_t cycles, uint32_t rtc);
+#endif
+
+/**
+ * Writes a record into the trace ring, overwriting the oldest one
+ *
+ * Use trace_begin and trace_end instead, which are removed together with
+ * the tracing. Safe to call from interrupt handlers.
+ *
+ * @param id Phase, or'ed with TRACE_END for the end of the phase
+ *
+ */
+void _trace_point(uint8_t id);
+
+#endif /* __TRACE_H_ */
@@ -0,0 +1,83 @@
+#ifndef __TXPWR_H_
+#define __TXPWR_H_
+
+#include <stdint.h>
+
+#include "neighbor.h"
+
+/* TX power in dBm after a cold boot */
+#define TXPWR_DEFAULT -8
+
+/* RSSI in dBm at which neighbors should receive, leaves about 10dB of margin
+ * to the sensitivity of BLE 2Mbit. Lower it for the Coded PHY profiles. */
+#define TXPWR_TARGET_RSSI -80
+
+/* Neighbors heard within this many cycles must be reached */
+#define TXPWR_HORIZON 32
+
+/* Raise power by one level after this many cycles without any packet */
+#define TXPWR_STALL_CYCLES 4
+
+/* Weight of new sample in path loss moving average is 1/2^TXPWR_SHIFT */
+#define TXPWR_SHIFT 2
+
+/* TX power levels of the nRF52840 in dBm */
+#define TXPWR_LEVELS                                                           \
+  { -20, -16, -12, -8, -4, 0, 4, 8 }
+
+typedef struct {
+  /* Marks the block as initialized after a cold boot */
+  uint32_t magic;
+  /* Index of the selected TX power level */
+  uint32_t level;
+  /* Levels added on top of the level required by known neighbors */
+  uint32_t boost;
+  /* Consecutive cycles without any received packet */
+  uint32_t stalled;
+} txpwr_state_t;
+
+/**
+ * Initializes TX power control
+ *
+ * Selected level is kept in retained RAM and only reset to TXPWR_DEFAULT if
+ * the retained block is not valid, i.e. after a cold boot.
+ *
+ * @returns 0 if retained state was recovered, 1 if it was reset
+ */
+int txpwr_init(void);
+
+/**
+ * Updates path loss statistics of a neighbor
+ *
+ * Path loss is the difference between the TX power advertised by the neighbor
+ * and the RSSI of its packet, which also holds for the reverse direction.
+ *
+ * @param entry Neighbor returned by nbr_update
+ * @param rssi RSSI of received packet in -dBm
+ * @param tx_power TX power advertised by the neighbor in dBm
+ *
+ */
+void txpwr_update(nbr_entry_t *entry, uint8_t rssi, int8_t tx_power);
+
+/**
+ * Selects TX power for the next cycle
+ *
+ * Picks the lowest level at which all neighbors heard within TXPWR_HORIZON
+ * cycles receive with TXPWR_TARGET_RSSI. Every TXPWR_STALL_CYCLES cycles
+ * without any packet, one more level is added. The boost is reduced by one
+ * level in every cycle in which packets were received.
+ *
+ * @param n_heard Number of packets received in the cycle
+ *
+ * @returns TX power in dBm
+ */
+int txpwr_adapt(unsigned int n_heard);
+
+/**
+ * Selected TX power
+ *
+ * @returns TX power in dBm
+ */
+int txpwr_get(void);
+
+#endif /* __TXPWR_H_ */
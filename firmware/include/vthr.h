@@ -0,0 +1,74 @@
+#ifndef __VTHR_H_
+#define __VTHR_H_
+
+#include <stdint.h>
+
+/* Lower threshold by this many ADC codes per cycle, i.e. by about 7mV */
+#define VTHR_STEP 2
+
+/* Raise threshold by this many ADC codes after a brownout, about 0.1V */
+#define VTHR_BACKOFF 32
+
+typedef struct {
+  /* Marks the block as initialized after a cold boot */
+  uint32_t magic;
+  /* Turn-on threshold and its limits in binary ADC code */
+  uint32_t v_on;
+  uint32_t v_min;
+  uint32_t v_max;
+  /* Brownouts before the power-fail warning seen so far */
+  uint32_t brownouts;
+} vthr_state_t;
+
+/**
+ * Initializes turn-on threshold control
+ *
+ * Threshold is kept in retained RAM and only reset to the default if the
+ * retained block is not valid, i.e. after a cold boot.
+ *
+ * @param v_default Threshold after a cold boot in binary ADC code
+ * @param v_min Voltage required at the beginning of the first round, which
+ * is also the lowest threshold, in binary ADC code
+ * @param v_max Highest threshold in binary ADC code
+ *
+ * @returns 0 if retained state was recovered, 1 if it was reset
+ */
+int vthr_init(unsigned int v_default, unsigned int v_min, unsigned int v_max);
+
+/**
+ * Backs off from a threshold that led to a brownout
+ *
+ * Raises the threshold by VTHR_BACKOFF if acct counted a brownout during
+ * waiting or discovery since the last call. Called on boot, because a cycle
+ * that browns out never gets to vthr_adapt().
+ *
+ * @param brownouts Number of brownouts during waiting and discovery, as
+ * counted by acct
+ *
+ * @returns Turn-on threshold in binary ADC code
+ */
+unsigned int vthr_backoff(uint32_t brownouts);
+
+/**
+ * Adapts turn-on threshold for the next cycle
+ *
+ * Lowers the threshold by VTHR_STEP as long as the first round of a cycle
+ * started with at least v_min, which shortens charging. If the capacitor
+ * discharged below v_min while waiting, the threshold is raised by the
+ * shortfall.
+ *
+ * @param v_disco Voltage at the beginning of the first round in binary ADC
+ * code
+ *
+ * @returns Turn-on threshold in binary ADC code
+ */
+unsigned int vthr_adapt(unsigned int v_disco);
+
+/**
+ * Selected turn-on threshold
+ *
+ * @returns Turn-on threshold in binary ADC code
+ */
+unsigned int vthr_get(void);
+
+#endif /* __VTHR_H_ */
@@ -0,0 +1,123 @@
+#ifndef __WARMBOOT_H_
+#define __WARMBOOT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Last flash page is reserved for warm boot records, see linker script */
+#define WARMBOOT_NVM_ADDR 0xFF000UL
+#define WARMBOOT_NVM_SIZE 4096UL
+
+/* NVM record is due every this many cycles */
+#define WARMBOOT_NVM_INTERVAL 64
+
+typedef struct {
+  uint32_t magic;
+  /* PLL disciplined flync period in RTC ticks */
+  uint32_t period;
+  /* Estimated flicker period in RTC ticks with PLL_FRAC_BITS fraction bits */
+  int32_t freq;
+  /* State of the pseudo random number generator */
+  uint32_t prng[4];
+  /* Checksum over all previous fields */
+  uint32_t crc;
+} warmboot_state_t;
+
+/* Origin of state after boot */
+enum WarmbootSource {
+  /* No valid state, full calibration required */
+  WARMBOOT_COLD = 0,
+  /* State recovered from NVM record, RAM was lost */
+  WARMBOOT_NVM = 1,
+  /* State recovered from retained RAM */
+  WARMBOOT_RAM = 2
+};
+
+/**
+ * Keeps or clears a block in retained RAM
+ *
+ * Retained blocks live in the .noinit section and start with a magic word,
+ * see linker script. A block without the magic word holds garbage after a
+ * cold boot and is zeroed. Modules invalidate the magic word beforehand if
+ * they find further fields out of range. Inline, so that it runs before RAM
+ * functions are loaded and in host builds.
+ *
+ * @param block Retained block, starting with a uint32_t magic word
+ * @param size Size of the block in bytes
+ * @param magic Magic word of the module
+ *
+ * @returns 0 if the block was kept, 1 if it was cleared
+ */
+static inline int retained_init(void *block, size_t size, uint32_t magic) {
+  if (*(uint32_t *)block == magic)
+    return 0;
+  memset(block, 0, size);
+  *(uint32_t *)block = magic;
+  return 1;
+}
+
+/**
+ * Checks for valid warm boot state
+ *
+ * Must be called before RAM is initialized, as it only touches retained RAM
+ * and flash. Validates the retained block and falls back to the latest valid
+ * record in NVM if the block is damaged. State is discarded after a watchdog
+ * reset.
+ *
+ * @returns Origin of recovered state
+ */
+enum WarmbootSource warmboot_restore(void);
+
+/**
+ * Result of the last call to warmboot_restore
+ *
+ * @returns Origin of recovered state
+ */
+enum WarmbootSource warmboot_source(void);
+
+/**
+ * Access to retained state block
+ *
+ * Modules update their fields in place and call warmboot_save() afterwards.
+ *
+ * @returns Reference to retained state block
+ */
+warmboot_state_t *warmboot_state(void);
+
+/**
+ * Seals retained state block
+ *
+ * Updates checksum of the retained block and counts a cycle towards the next
+ * NVM record. Doesn't touch flash, so that it can be called after the
+ * power-fail warning.
+ *
+ * @returns 0 on success
+ */
+int warmboot_save(void);
+
+/**
+ * Writes sealed state block to NVM if a record is overdue
+ *
+ * Writing flash takes several microjoules. Only call it when the capacitor is
+ * known to hold enough energy, i.e. not after the power-fail warning.
+ *
+ * @param max_age Write if at least this many cycles were sealed since the
+ * last record or if no record exists since cold boot
+ *
+ * @returns 0 if a record was written, 1 if none was due, -1 on error
+ */
+int warmboot_nvm_update(unsigned int max_age);
+
+/**
+ * Prepares NVM for records
+ *
+ * Erases the reserved page if it has no space left. Erasing is slow and
+ * should only be done on cold boot, when energy is burnt anyway.
+ *
+ * @returns 0 on success
+ */
+int warmboot_nvm_prepare(void);
+
+#endif /* __WARMBOOT_H_ */
@@ -0,0 +1,154 @@
+import re
+import struct
+import sys
+import click
+from pathlib import Path
+
+BASE_PATH = Path(__file__).resolve().parent
+
+# Record layout, must match LOG_* definitions in include/log.h
+LOG_MAGIC = 0xA5
+LOG_ID_DROPPED = 0xFFFFF
+LOG_ID_MASK = 0xFFFFF
+
+# printf conversions supported with 32-bit integer arguments
+CONVERSION = re.compile(r"%([-+ #0]*\d*)(?:hh|h|l|z)?([diouxXc%])")
+
+
+def read_section(elf_path, name):
+    """Returns address and contents of a section of a little-endian ELF file
+
+    Returns None if there is no such section.
+    """
+    elf = Path(elf_path).read_bytes()
+    if elf[:4] != b"\x7fELF" or elf[5] != 1:
+        raise click.ClickException(f"{elf_path} is no little-endian ELF file")
+
+    if elf[4] == 1:
+        (shoff,) = struct.unpack_from("<I", elf, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", elf, 0x2E)
+        shdr = "<IIIIII"
+    else:
+        (shoff,) = struct.unpack_from("<Q", elf, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", elf, 0x3A)
+        shdr = "<IIQQQQ"
+
+    # Name offset, type, flags, address, file offset and size of sections
+    sections = [
+        struct.unpack_from(shdr, elf, shoff + i * shentsize) for i in range(shnum)
+    ]
+    strtab = sections[shstrndx]
+    for sh_name, _, _, addr, offset, size in sections:
+        start = strtab[4] + sh_name
+        if elf[start : elf.index(b"\0", start)].decode() == name:
+            return addr, elf[offset : offset + size]
+    return None
+
+
+def load_formats(elf_path):
+    """Loads format strings of log_printf from the .logstr section
+
+    Returns dict mapping format ID, i.e. address of the string truncated to
+    the ID bits, to string. The firmware places the section at address 0, so
+    that IDs are offsets. Host builds load it, with the test built as
+    position-dependent executable.
+    """
+    section = read_section(elf_path, ".logstr")
+    if section is None:
+        raise click.ClickException(f"{elf_path} has no .logstr section")
+    addr, data = section
+
+    formats = dict()
+    offset = 0
+    while offset < len(data):
+        end = data.index(b"\0", offset)
+        if end > offset:
+            formats[(addr + offset) & LOG_ID_MASK] = data[offset:end].decode(
+                "ascii", "replace"
+            )
+        # Strings of different objects may be padded to alignment
+        offset = end + 1
+    return formats
+
+
+def format_record(fmt, args):
+    """Formats raw 32-bit arguments like the printf implementation would"""
+    args = iter(args)
+
+    def convert(m):
+        flags, conv = m.groups()
+        if conv == "%":
+            return "%"
+        val = next(args, 0)
+        if conv in "di":
+            val = struct.unpack("<i", struct.pack("<I", val))[0]
+            conv = "d"
+        elif conv == "u":
+            conv = "d"
+        return ("%" + flags + conv) % val
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def decode(stream, formats):
+    """Yields (time, text) for every record in a stream of log words
+
+    Bytes are skipped until the next record header, so that the decoder can
+    start in the middle of a transfer.
+    """
+    buf = b""
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            break
+        buf += chunk
+
+        pos = 0
+        while len(buf) - pos >= 8:
+            (header, time) = struct.unpack_from("<II", buf, pos)
+            nargs = (header >> 20) & 0xF
+            fmt_id = header & LOG_ID_MASK
+            if (header >> 24) != LOG_MAGIC or (
+                fmt_id != LOG_ID_DROPPED and fmt_id not in formats
+            ):
+                pos += 1
+                continue
+            if len(buf) - pos < 8 + 4 * nargs:
+                break
+            args = struct.unpack_from(f"<{nargs}I", buf, pos + 8)
+            pos += 8 + 4 * nargs
+
+            if fmt_id == LOG_ID_DROPPED:
+                yield time, f"<{args[0] if args else 0} records dropped>\n"
+            else:
+                yield time, format_record(formats[fmt_id], args)
+        buf = buf[pos:]
+
+
+@click.command(short_help="Decodes binary log records drained from the node")
+@click.option(
+    "--elf-path",
+    "-e",
+    type=click.Path(exists=True, dir_okay=False),
+    default=str(BASE_PATH / "_build" / "build.elf"),
+    help="Path of firmware ELF with the format strings",
+)
+@click.option(
+    "--input-path",
+    "-i",
+    type=click.File("rb"),
+    default="-",
+    help="Raw bytes received from the UART, defaults to stdin",
+)
+def cli(elf_path, input_path):
+
+    formats = load_formats(elf_path)
+    for time, text in decode(input_path, formats):
+        sys.stdout.write(f"{time:10d} {text}")
+        if not text.endswith("\n"):
+            sys.stdout.write("\n")
+        sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    cli()
@@ -0,0 +1,132 @@
+#include <stdint.h>
+
+#ifndef ACCT_HOST
+#include "nrf52840.h"
+
+#include "flync.h"
+#include "timer.h"
+#endif
+
+#include "acct.h"
+#include "log.h"
+#include "warmboot.h"
+
+#define ACCT_MAGIC 0xACC7ACC8UL
+
+static acct_state_t state __attribute__((section(".noinit")));
+
+#ifdef ACCT_HOST
+static uint32_t host_now;
+static uint32_t host_rtc;
+
+void acct_host_clock(uint32_t now, uint32_t rtc) {
+  host_now = now;
+  host_rtc = rtc;
+}
+
+#define acct_now() host_now
+#define acct_rtc() host_rtc
+#define acct_period() ACCT_HOST_PERIOD
+#else
+#define acct_now() timer_now()
+#define acct_rtc() NRF_RTC0->COUNTER
+#define acct_period() flync_period()
+#endif
+
+/* Samples system time and RTC counter of the same flync period */
+__attribute__((long_call, section(".ramfunctions"))) static void
+acct_timestamp(uint32_t *now, uint32_t *rtc) {
+  do {
+    *now = acct_now();
+    *rtc = acct_rtc();
+  } while (acct_now() != *now);
+}
+
+int acct_init(void) {
+  uint32_t now, rtc;
+  acct_timestamp(&now, &rtc);
+
+  int cleared = retained_init(&state, sizeof(state), ACCT_MAGIC);
+  /* Power failed before the warning, system time restarted */
+  if (!cleared && !state.pof)
+    state.phases[state.phase].brownouts++;
+
+  state.phase = ACCT_CHARGE;
+  state.t_enter = now;
+  state.rtc_enter = rtc;
+  return cleared;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void
+acct_enter(enum AcctPhase phase) {
+  uint32_t now, rtc;
+  acct_timestamp(&now, &rtc);
+
+  /* Period may have changed in between, which is below the resolution */
+  uint32_t tcks = now - state.t_enter;
+  uint32_t rtc_tcks = tcks * acct_period() + rtc - state.rtc_enter;
+
+  acct_phase_t *p = &state.phases[state.phase];
+  p->n++;
+  p->tcks += tcks;
+  p->rtc += rtc_tcks;
+  unsigned int bin = (rtc_tcks > 0) ? 32 - __builtin_clz(rtc_tcks) : 0;
+  p->hist[(bin < ACCT_HIST_BINS) ? bin : ACCT_HIST_BINS - 1]++;
+
+  if ((state.phase == ACCT_POF) && (phase == ACCT_CHARGE)) {
+    state.n_cycles++;
+    state.pof = 1;
+  } else if (phase != ACCT_CHARGE)
+    state.pof = 0;
+  state.phase = phase;
+  state.t_enter = now;
+  state.rtc_enter = rtc;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) uint32_t
+acct_radio_start(void) {
+  return acct_rtc();
+}
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+acct_radio_stop(enum AcctRadio radio, uint32_t rtc_start) {
+  uint32_t rtc = acct_rtc();
+  /* RTC was cleared at a flync tick in between */
+  unsigned int rtc_tcks = (rtc >= rtc_start)
+                              ? rtc - rtc_start
+                              : rtc + acct_period() - rtc_start;
+  state.radio_rtc[radio] += rtc_tcks;
+  return rtc_tcks;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void
+acct_radio_add(enum AcctRadio radio, unsigned int rtc_tcks) {
+  state.radio_rtc[radio] += rtc_tcks;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void acct_report(void) {
+  if ((state.n_cycles == 0) || (state.n_cycles % ACCT_REPORT_CYCLES != 0))
+    return;
+
+  log_printf("acct cycles %u radio tx %u rx %u\n", state.n_cycles,
+             state.radio_rtc[ACCT_RADIO_TX], state.radio_rtc[ACCT_RADIO_RX]);
+  /* One record per phase, the histogram only by its most frequent and its
+   * highest bin, so that the report leaves the ring to the cycle's records */
+  for (unsigned int i = 0; i < ACCT_N_PHASES; i++) {
+    const acct_phase_t *p = &state.phases[i];
+    unsigned int peak = 0, max = 0;
+    for (unsigned int bin = 0; bin < ACCT_HIST_BINS; bin++) {
+      if (p->hist[bin] > p->hist[peak])
+        peak = bin;
+      if (p->hist[bin] > 0)
+        max = bin;
+    }
+    log_printf("acct phase %u n %u rtc %u brownouts %u bins %u %u\n", i, p->n,
+               p->rtc, p->brownouts, peak, max);
+  }
+}
+
+__attribute__((long_call, section(".ramfunctions"))) const acct_state_t *
+acct_stats(void) {
+  return &state;
+}
@@ -0,0 +1,100 @@
+#include "nrf52840.h"
+#include "nrf52840_bitfields.h"
+#include "nrf_saadc.h"
+#include <stdint.h>
+
+#include "charge.h"
+#include "flync.h"
+#include "pt.h"
+#include "scheduler.h"
+
+/* Limits that can never be crossed by a 10 bit conversion */
+#define LIMIT_HIGH_OFF INT16_MAX
+#define LIMIT_LOW_OFF INT16_MIN
+
+static volatile pt_event_t above_evt = pt_event_init();
+static volatile pt_event_t below_evt = pt_event_init();
+
+static volatile int16_t limit_high = LIMIT_HIGH_OFF;
+static volatile int16_t limit_low = LIMIT_LOW_OFF;
+
+__attribute__((long_call, section(".ramfunctions"))) static inline void
+limit_write(void) {
+  NRF_SAADC->CH[0].LIMIT =
+      ((uint32_t)(uint16_t)limit_high << SAADC_CH_LIMIT_HIGH_Pos) |
+      ((uint32_t)(uint16_t)limit_low << SAADC_CH_LIMIT_LOW_Pos);
+}
+
+int charge_init(void) {
+  charge_cancel();
+  NVIC_ClearPendingIRQ(SAADC_IRQn);
+  NVIC_EnableIRQ(SAADC_IRQn);
+  return 0;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) volatile pt_event_t *
+charge_above(unsigned int v_level) {
+  NRF_SAADC->INTENCLR = SAADC_INTENCLR_CH0LIMITH_Msk;
+  limit_high = v_level;
+  limit_write();
+  pt_event_clear(&above_evt);
+  NRF_SAADC->EVENTS_CH[0].LIMITH = 0;
+  NRF_SAADC->INTENSET = SAADC_INTENSET_CH0LIMITH_Msk;
+  return &above_evt;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) volatile pt_event_t *
+charge_below(unsigned int v_level) {
+  NRF_SAADC->INTENCLR = SAADC_INTENCLR_CH0LIMITL_Msk;
+  limit_low = v_level;
+  limit_write();
+  pt_event_clear(&below_evt);
+  NRF_SAADC->EVENTS_CH[0].LIMITL = 0;
+  NRF_SAADC->INTENSET = SAADC_INTENSET_CH0LIMITL_Msk;
+  return &below_evt;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) int
+charge_cancel(void) {
+  NRF_SAADC->INTENCLR =
+      SAADC_INTENCLR_CH0LIMITH_Msk | SAADC_INTENCLR_CH0LIMITL_Msk;
+  limit_high = LIMIT_HIGH_OFF;
+  limit_low = LIMIT_LOW_OFF;
+  limit_write();
+  NRF_SAADC->EVENTS_CH[0].LIMITH = 0;
+  NRF_SAADC->EVENTS_CH[0].LIMITL = 0;
+  return 0;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void _charge_limit(void) {
+  /* Thresholds are one-shot, disarm them before notifying the application */
+  if (NRF_SAADC->EVENTS_CH[0].LIMITH == 1) {
+    NRF_SAADC->EVENTS_CH[0].LIMITH = 0;
+    if (NRF_SAADC->INTEN & SAADC_INTEN_CH0LIMITH_Msk) {
+      NRF_SAADC->INTENCLR = SAADC_INTENCLR_CH0LIMITH_Msk;
+      limit_high = LIMIT_HIGH_OFF;
+      limit_write();
+      pt_event_set(&above_evt);
+      sched_notify(SCHED_EVT_CHARGE);
+    }
+  }
+  if (NRF_SAADC->EVENTS_CH[0].LIMITL == 1) {
+    NRF_SAADC->EVENTS_CH[0].LIMITL = 0;
+    if (NRF_SAADC->INTEN & SAADC_INTEN_CH0LIMITL_Msk) {
+      NRF_SAADC->INTENCLR = SAADC_INTENCLR_CH0LIMITL_Msk;
+      limit_low = LIMIT_LOW_OFF;
+      limit_write();
+      pt_event_set(&below_evt);
+      sched_notify(SCHED_EVT_CHARGE);
+    }
+  }
+}
+
+#if FLYNC_HW_CAPTURE
+__attribute__((long_call, section(".ramfunctions"))) void
+SAADC_IRQHandler(void) {
+  /* Conversions on flync ticks only wake up the CPU on threshold crossings,
+   * system time is kept by the hardware tick counter */
+  _charge_limit();
+}
+#endif
@@ -0,0 +1,99 @@
+#include <stdint.h>
+
+#include "density.h"
+#include "warmboot.h"
+
+#define DENSITY_MAGIC 0xDE5C0DE6UL
+
+static density_state_t state __attribute__((section(".noinit")));
+
+int density_init(void) {
+  if (!retained_init(&state, sizeof(state), DENSITY_MAGIC))
+    return 0;
+
+  /* Start from a single neighbor */
+  state.heard = DENSITY_HORIZON << DENSITY_ACC_FRAC_BITS;
+  state.expected = DENSITY_HORIZON << DENSITY_ACC_FRAC_BITS;
+  state.density = 2 << DENSITY_FRAC_BITS;
+  return 1;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void
+density_count(enum RadioLogicalAddress type) {
+  switch (type) {
+  case LA_BCN:
+    state.win_bcn++;
+    break;
+  case LA_ACK_YES:
+    state.win_ack_yes++;
+    break;
+  case LA_ACK_NO:
+    state.win_ack_no++;
+    break;
+  }
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void
+density_count_crc_error(void) {
+  state.win_crc_err++;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void
+density_update(unsigned int cycle_tcks, unsigned int n_windows) {
+  /*
+   * A neighbor that is in the window sends a heading beacon and a trailing
+   * ack, but we may miss either. A damaged packet stems from at least two
+   * colliding neighbors.
+   */
+  unsigned int n_acks = state.win_ack_yes + state.win_ack_no;
+  unsigned int heard = (state.win_bcn > n_acks) ? state.win_bcn : n_acks;
+  heard += 2 * state.win_crc_err;
+
+  if (n_windows == 0)
+    n_windows = 1;
+  if (cycle_tcks < n_windows)
+    cycle_tcks = n_windows;
+
+  /* Hearings of a single neighbor expected in this cycle */
+  const uint64_t horizon = (uint64_t)DENSITY_HORIZON << DENSITY_ACC_FRAC_BITS;
+  uint64_t expected =
+      ((uint64_t)n_windows * n_windows << DENSITY_ACC_FRAC_BITS) / cycle_tcks;
+  if (expected == 0)
+    expected = 1;
+  if (expected > horizon)
+    expected = horizon;
+
+  /* Forget as much as this cycle adds to the expected hearings */
+  uint64_t sum_heard = state.heard - (uint64_t)state.heard * expected / horizon +
+                       ((uint64_t)heard << DENSITY_ACC_FRAC_BITS);
+  /* Estimate is bounded anyway, keep the sum from overflowing */
+  if (sum_heard > DENSITY_MAX * horizon)
+    sum_heard = DENSITY_MAX * horizon;
+  state.heard = (uint32_t)sum_heard;
+  state.expected -= (uint64_t)state.expected * expected / horizon;
+  state.expected += expected;
+
+  uint64_t density =
+      (1 << DENSITY_FRAC_BITS) +
+      ((uint64_t)state.heard << DENSITY_FRAC_BITS) / state.expected;
+  if (density > (DENSITY_MAX << DENSITY_FRAC_BITS))
+    density = DENSITY_MAX << DENSITY_FRAC_BITS;
+  state.density = (uint32_t)density;
+
+  state.n_windows += n_windows;
+  state.n_bcn += state.win_bcn;
+  state.n_ack_yes += state.win_ack_yes;
+  state.n_ack_no += state.win_ack_no;
+  state.n_crc_err += state.win_crc_err;
+
+  state.win_bcn = state.win_ack_yes = state.win_ack_no = state.win_crc_err = 0;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+density_get(void) {
+  if (state.density > (DENSITY_MAX << DENSITY_FRAC_BITS))
+    return DENSITY_MAX << DENSITY_FRAC_BITS;
+  return state.density;
+}
+
+const density_state_t *density_stats(void) { return &state; }
@@ -8,12 +8,19 @@
 #include "nrf_rtc.h"
 #include "nrf_saadc.h"
 
+#include "acct.h"
+#include "density.h"
 #include "disco.h"
 #include "flync.h"
+#include "hfclk.h"
+#include "hop.h"
+#include "neighbor.h"
 #include "peripherals.h"
 #include "printf.h"
 #include "prng.h"
+#include "scheduler.h"
 #include "timer.h"
+#include "trace.h"
 
 static disco_queue_t disco_queue = pt_queue_init();
 
@@ -22,20 +29,28 @@ static volatile pt_event_t radio_evt = pt_event_init();
 /* Payload of transmitted beacon/acknowledgement */
 static disco_pdu_t tx_pdu;
 
-/* Buffer for received beacon/acknowledgment payload */
-static disco_pdu_t rx_pdu;
+/* Received beacon/acknowledgment payload and the radio registers captured at
+ * the end of the packet */
+typedef struct {
+  disco_pdu_t pdu;
+  disco_rx_meta_t meta;
+} disco_rx_t;
 
-__attribute__((long_call, section(".ramfunctions"))) int
-disco_strfmt(char *buf, disco_data_t *disco_data, unsigned int t_chr,
-             size_t buf_size) {
-  int count =
-      snprintf(buf, buf_size, "%08X,%u\n", disco_data->device_id, t_chr);
-  return count;
-}
+/* Radio receives into the tail slot, RADIO_IRQHandler commits it and
+ * disco_thread handles committed packets */
+static pt_queue(disco_rx_t, DISCO_RX_BUFS) rx_queue = pt_queue_init();
+
+/* System time of the slot in which the current round started */
+static uint32_t round_now;
+
+/* Radio is in RX window and restarts reception after every packet */
+static volatile bool rx_active = false;
+/* Reception was not restarted, because all buffers were in use */
+static volatile bool rx_stalled = false;
 
 int disco_init(unsigned int gpio_pin) {
   tx_pdu.device_id = NRF_FICR->DEVICEADDR[0];
-  return radio_init(gpio_pin);
+  return radio_init(gpio_pin, sizeof(disco_pdu_t));
 }
 
 __attribute__((long_call, section(".ramfunctions"))) disco_data_t *
@@ -44,13 +59,14 @@ disco_results_pop(void) {
 }
 
 static inline int disco_prepare_beacon(uint16_t t_chr,
-                                       unsigned int start_time_tcks) {
+                                       unsigned int beacon_tcks) {
+  trace_begin(TRACE_BEACON_PREP);
 
-  /* Start HFCLK */
-  NRF_CLOCK->TASKS_HFCLKSTART = 1;
+  /* Start HFCLK and measure how long the crystal takes */
+  hfclk_start();
 
   /* Set timer to start beacon transmission */
-  NRF_RTC0->CC[0] = start_time_tcks + 20;
+  NRF_RTC0->CC[0] = beacon_tcks;
   NRF_PPI->CHENSET = PPI_CHENSET_CH28_Msk;
   NRF_RTC0->EVTENSET = RTC_EVTENSET_COMPARE0_Msk;
 
@@ -71,6 +87,7 @@ static inline int disco_prepare_beacon(uint16_t t_chr,
   pt_event_clear(&radio_evt);
   radio_enable_event(&(NRF_RADIO->EVENTS_TXREADY), RADIO_INTENSET_TXREADY_Msk);
 
+  trace_end(TRACE_BEACON_PREP);
   return 0;
 }
 
@@ -96,6 +113,9 @@ disco_prepare_rx() {
 __attribute__((long_call, section(".ramfunctions"))) static inline int
 disco_send_ack() {
 
+  /* Stop restarting RX from interrupt */
+  rx_active = false;
+
   /* Stop RX and turnaround for transmitting ACK */
   NRF_RADIO->SHORTS &= ~NRF_RADIO_SHORT_ADDRESS_RSSISTART_MASK;
   NRF_RADIO->SHORTS |=
@@ -113,72 +133,156 @@ disco_send_ack() {
 }
 
 __attribute__((long_call, section(".ramfunctions"))) static inline int
-disco_handle_pkt() {
+disco_handle_pkt(const disco_rx_t *rx) {
+  const disco_rx_meta_t *meta = &rx->meta;
 
-  /* Go back to RX if packet is damaged */
-  if (NRF_RADIO->CRCSTATUS == 0) {
+  /* Drop packet if it is damaged */
+  if (meta->crc_ok == 0) {
+    density_count_crc_error();
     return -1;
   }
-  radio_enable_event(&(NRF_RADIO->EVENTS_END), RADIO_INTENSET_END_Msk);
 
   disco_data_t disco_data;
-  disco_data.device_id = rx_pdu.device_id;
-  disco_data.rssi = NRF_RADIO->RSSISAMPLE;
-  if ((NRF_RADIO->RXMATCH == LA_BCN) || (NRF_RADIO->RXMATCH == LA_ACK_YES) ||
-      (NRF_RADIO->RXMATCH == LA_ACK_NO)) {
-    disco_data.type = NRF_RADIO->RXMATCH;
+  disco_data.device_id = rx->pdu.device_id;
+  disco_data.rssi = meta->rssi;
+  disco_data.t_chr = rx->pdu.t_chr;
+  /* Peers only meet when they beacon in the same slot */
+  disco_data.t_next = round_now + rx->pdu.next_delta;
+  disco_data.tx_power = rx->pdu.tx_power;
+#if DISCO_GOSSIP_IDS > 0
+  memcpy(disco_data.gossip, rx->pdu.gossip, sizeof(disco_data.gossip));
+#endif
+  if ((meta->rxmatch == LA_BCN) || (meta->rxmatch == LA_ACK_YES) ||
+      (meta->rxmatch == LA_ACK_NO)) {
+    disco_data.type = meta->rxmatch;
+    density_count(disco_data.type);
     pt_queue_push(&disco_queue, disco_data);
     return 0;
   }
   return -1;
 }
 
+/* Sub-slot in which this node beacons in the current round */
+__attribute__((long_call, section(".ramfunctions"))) static inline unsigned int
+disco_subslot(unsigned int n_subslots) {
+#if DISCO_SUBSLOT_BY_ID
+  uint32_t id = tx_pdu.device_id;
+  return (id ^ (id >> 16)) % n_subslots;
+#else
+  return prng_urand(0, n_subslots);
+#endif
+}
+
 __attribute__((long_call, section(".ramfunctions"))) void
-disco_thread(struct pt *pt, uint16_t t_chr, unsigned int rx_wdw_tcks,
-             unsigned int start_time_tcks) {
+disco_thread(struct pt *pt, uint16_t t_chr, uint32_t t_next,
+             unsigned int rx_wdw_tcks, unsigned int start_time_tcks,
+             unsigned int exit_pkts, bool meet) {
   pt_begin(pt);
 
+  static timer_handle_t rtc_timer;
   static volatile pt_event_t *rtc_event;
-
-  if (start_time_tcks > 21) {
-    /* Wait for timer before starting HFCLK */
-    rtc_event = timer_rtc_set(start_time_tcks - 20);
-    pt_event_wait(pt, rtc_event);
-  }
+  static unsigned int n_pkts;
+  static uint32_t radio_start;
+  static unsigned int tx_tcks;
+  static unsigned int spacing;
+  static unsigned int n_subslots;
+  static unsigned int subslot;
+  static unsigned int beacon_tcks;
+
+  /* Beacon, RX window and trailing beacon stay on the channel of this slot */
+  round_now = timer_now();
+  tx_pdu.next_delta = (uint16_t)(t_next - round_now);
+  tx_pdu.tx_power = radio_txpower();
+#if DISCO_GOSSIP_IDS > 0
+  /* Members of the packed PDU may be unaligned */
+  uint16_t gossip[DISCO_GOSSIP_IDS];
+  nbr_recent(gossip, DISCO_GOSSIP_IDS);
+  memcpy(tx_pdu.gossip, gossip, sizeof(gossip));
+#endif
+  /* Both sides of a planned meeting must tune to the same channel */
+  NRF_RADIO->FREQUENCY =
+      meet ? hop_meet_channel() : hop_channel(hop_slot(round_now));
+
+  /* Sub-slots keep beacons and acknowledgements of different ones apart and
+   * all beacons within the flync period */
+  spacing = subslot_spacing(radio_airtime_us(), radio_profile()->tifs_us);
+  n_subslots = subslot_count(flync_period(), start_time_tcks, spacing);
+  /* Start HFCLK no earlier than the crystal needs, given recent startups. A
+   * late round moves to a later sub-slot, or is skipped if none leaves room,
+   * so that the beacon doesn't slip into the next flync period. */
+  unsigned int lead = hfclk_lead();
+  subslot = subslot_reachable(NRF_RTC0->COUNTER, lead, start_time_tcks,
+                              disco_subslot(n_subslots), n_subslots, spacing);
+  if (subslot == n_subslots)
+    pt_exit(pt, PT_STATUS_FINISHED);
+  beacon_tcks = subslot_beacon(start_time_tcks, subslot, spacing);
+
+  /* Wait for timer before starting HFCLK */
+  rtc_event = timer_rtc_set(&rtc_timer, beacon_tcks - lead);
+  pt_event_wait(pt, rtc_event);
 
   /* Prepare and send beacon, once HFCLK is up */
-  disco_prepare_beacon(t_chr, start_time_tcks);
+  disco_prepare_beacon(t_chr, beacon_tcks);
 
   /* Wait until radio has ramped up for TX */
   pt_event_wait(pt, &radio_evt);
+  /* Beacon goes out, radio turns around to RX by shortcuts */
+  trace_begin(TRACE_TURNAROUND);
+  radio_start = acct_radio_start();
 
-  /* Switch to RX buffer */
-  NRF_RADIO->PACKETPTR = (uint32_t)&rx_pdu;
+  /* Switch to first RX buffer */
+  pt_queue_reset(&rx_queue);
+  rx_stalled = false;
+  rx_active = true;
+  NRF_RADIO->PACKETPTR = (uint32_t)&pt_queue_tail(&rx_queue)->pdu;
 
   /* Wait for radio to ramp up to RX */
   pt_event_clear(&radio_evt);
   radio_enable_event(&(NRF_RADIO->EVENTS_RXREADY), RADIO_INTENSET_RXREADY_Msk);
   pt_event_wait(pt, &radio_evt);
+  tx_tcks = acct_radio_stop(ACCT_RADIO_TX, radio_start);
+  radio_start = acct_radio_start();
 
   disco_prepare_rx();
+  trace_end(TRACE_TURNAROUND);
 
-  unsigned int timeout = NRF_RTC0->COUNTER + rx_wdw_tcks;
-  if (timeout > NRF_RTC0->CC[1])
-    rtc_event = timer_rtc_set(timeout - NRF_RTC0->CC[1]);
-  else
-    rtc_event = timer_rtc_set(timeout);
+  /* Window covers the beacons of both sides in the radio profile plus the
+   * margin, at least up to the last sub-slot, and may extend into the next
+   * flync period */
+  unsigned int wdw_tcks =
+      subslot_window(n_subslots, subslot, spacing, rx_wdw_tcks);
+  rtc_event = timer_rtc_wait(&rtc_timer, wdw_tcks + 2 * radio_airtime_tcks());
 
-  /* Listen until rx window timer expires */
+  /* Listen until rx window timer expires or exit policy is met */
+  n_pkts = 0;
   while (!pt_event_get(rtc_event)) {
     enter_low_power();
-    /* We've received an address */
-    if (pt_event_get(&radio_evt)) {
-      pt_event_clear(&radio_evt);
-      disco_handle_pkt();
+    /* We've received one or more packets */
+    if (pt_event_take(&radio_evt)) {
+      disco_rx_t *rx;
+      while ((rx = pt_queue_peek(&rx_queue)) != NULL) {
+        trace_begin(TRACE_HANDLE_PKT);
+        if (disco_handle_pkt(rx) == 0)
+          n_pkts++;
+        trace_end(TRACE_HANDLE_PKT);
+        pt_queue_drop(&rx_queue);
+      }
+      /* Buffers are free again, resume reception */
+      if (rx_stalled) {
+        rx_stalled = false;
+        NRF_RADIO->PACKETPTR = (uint32_t)&pt_queue_tail(&rx_queue)->pdu;
+        NRF_RADIO->TASKS_START = 1;
+      }
+      if ((exit_pkts > 0) && (n_pkts >= exit_pkts)) {
+        timer_cancel(&rtc_timer);
+        break;
+      }
     }
   }
-  /* Send trailing beacon */
+  acct_radio_stop(ACCT_RADIO_RX, radio_start);
+  /* Send trailing beacon, it takes as long as the heading one */
   disco_send_ack();
+  acct_radio_add(ACCT_RADIO_TX, tx_tcks);
   /* Wait until radio has ramped up for TX */
   pt_event_wait(pt, &radio_evt);
   /* Prepare radio to shut down after sending beacon */
@@ -191,18 +295,36 @@ __attribute__((long_call, section(".ramfunctions"))) void RADIO_IRQHandler() {
       (NRF_RADIO->INTENSET & RADIO_INTENSET_TXREADY_Msk)) {
     NRF_RADIO->EVENTS_TXREADY = 0;
     pt_event_set(&radio_evt);
+    sched_notify(SCHED_EVT_RADIO);
     NRF_RADIO->INTENCLR = RADIO_INTENCLR_TXREADY_Msk;
   }
   if ((NRF_RADIO->EVENTS_RXREADY == 1) &&
       (NRF_RADIO->INTENSET & RADIO_INTENSET_RXREADY_Msk)) {
     NRF_RADIO->EVENTS_RXREADY = 0;
     pt_event_set(&radio_evt);
+    sched_notify(SCHED_EVT_RADIO);
     NRF_RADIO->INTENCLR = RADIO_INTENCLR_RXREADY_Msk;
   }
   if ((NRF_RADIO->EVENTS_END == 1) &&
       (NRF_RADIO->INTENSET & RADIO_INTENSET_END_Msk)) {
     NRF_RADIO->EVENTS_END = 0;
+    if (rx_active) {
+      /* Capture packet status before the next reception overwrites it */
+      disco_rx_t *rx = pt_queue_tail(&rx_queue);
+      rx->meta.crc_ok = NRF_RADIO->CRCSTATUS;
+      rx->meta.rxmatch = NRF_RADIO->RXMATCH;
+      rx->meta.rssi = NRF_RADIO->RSSISAMPLE;
+      pt_queue_commit(&rx_queue);
+
+      /* Swap to next buffer and keep receiving, unless all are in use */
+      if ((rx = pt_queue_tail(&rx_queue)) != NULL) {
+        NRF_RADIO->PACKETPTR = (uint32_t)&rx->pdu;
+        NRF_RADIO->TASKS_START = 1;
+      } else
+        rx_stalled = true;
+    } else
+      NRF_RADIO->INTENCLR = RADIO_INTENCLR_END_Msk;
     pt_event_set(&radio_evt);
-    NRF_RADIO->INTENCLR = RADIO_INTENCLR_END_Msk;
+    sched_notify(SCHED_EVT_RADIO);
   }
 }
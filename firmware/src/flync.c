@@ -12,46 +12,45 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "charge.h"
 #include "disco.h"
 #include "peripherals.h"
+#include "pll.h"
 #include "printf.h"
 #include "prng.h"
 #include "timer.h"
+#include "trace.h"
+#include "warmboot.h"
 
 #define RTC_FREQUENCY 32768UL
-/* 10ms on the 32768Hz clock */
-#define FLYNC_CLOCK_RTCTICKS (RTC_FREQUENCY / FLYNC_CLOCK_FREQ_HZ)
-
-/* 1/Kp the proportional controller coefficient */
-#define FLYNC_K_P 32
-/* 1/Ki the integral controller coefficient */
-#define FLYNC_K_I 512
 
 /* RTC0 CC[1] always contains the current flync period estimate in rtc ticks */
 #define FLYNC_PERIOD_REG NRF_RTC0->CC[1]
 
+#if FLYNC_HW_CAPTURE
+#define FLYNC_PLL_DECIM FLYNC_DECIM_MAX
+#else
+/* Without hardware capture, the PLL is updated on every edge */
+#define FLYNC_PLL_DECIM 1
+#endif
+
 /* Dischargce capacitor to this value to avoid overvoltage shutdown */
 #define V_INIT_TRGT 3.0
 
+#if !FLYNC_HW_CAPTURE
 /* Allows to check if a flync clock edge has been detected between two RTC
  * events */
 static volatile bool clock_edge_detected = false;
+#endif
 
-int flync_setup_gpio(unsigned int gpio_pin);
-
-__attribute__((long_call, section(".ramfunctions"))) static inline int
-pi_control(unsigned int phase, unsigned int period) {
-  static int err_sum = 0;
-
-  /*
-   * We multiply by 128 to keep rounding losses low
-   * The setpoint for the phase is half the clock period
-   */
-  int err = phase * 128 - period * 128 / 2;
-  err_sum += err;
+/* State of the clock discipline */
+static pll_t pll;
+/* System time of last PLL update */
+static unsigned int t_last_update = 0;
+/* Edges counted since last PLL update */
+static unsigned int n_edges = 0;
 
-  return (err / FLYNC_K_P + err_sum / FLYNC_K_I) / 128;
-}
+int flync_setup_gpio(unsigned int gpio_pin);
 
 int flync_setup_gpio(unsigned int gpio_pin) {
   NRF_GPIOTE->CONFIG[2] = (GPIOTE_CONFIG_MODE_Task << 0) | (gpio_pin << 8) |
@@ -72,13 +71,93 @@ flync_phase2rtctcks(unsigned int phase) {
   return (FLYNC_PERIOD_REG + (phase * FLYNC_PERIOD_REG * 2)) / 6;
 }
 
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+flync_period(void) {
+  return FLYNC_PERIOD_REG;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) int
+flync_save(uint32_t *period, int32_t *freq) {
+  *period = FLYNC_PERIOD_REG;
+  *freq = pll.freq;
+  return 0;
+}
+
+#if FLYNC_HW_CAPTURE
+static int flync_setup_capture(void) {
+  /* TIMER1 counts RTC ticks and timestamps edges and period boundaries */
+  NRF_TIMER1->MODE = TIMER_MODE_MODE_LowPowerCounter;
+  NRF_TIMER1->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+  NRF_TIMER1->TASKS_CLEAR = 1;
+  NRF_TIMER1->TASKS_START = 1;
+
+  /* The RTC cannot capture, so every tick is counted. This keeps requesting
+   * the peripheral clock, see bench_wakeups for the estimated current */
+  NRF_RTC0->EVTENSET = RTC_EVTENSET_TICK_Msk;
+  NRF_PPI->CH[5].EEP = (uint32_t)&NRF_RTC0->EVENTS_TICK;
+  NRF_PPI->CH[5].TEP = (uint32_t)&NRF_TIMER1->TASKS_COUNT;
+
+  /* TIMER2 counts flicker edges and wakes up CPU every pll.decim edges */
+  NRF_TIMER2->MODE = TIMER_MODE_MODE_LowPowerCounter;
+  NRF_TIMER2->BITMODE = TIMER_BITMODE_BITMODE_16Bit;
+  NRF_TIMER2->CC[0] = pll.decim;
+  NRF_TIMER2->SHORTS = TIMER_SHORTS_COMPARE0_CLEAR_Msk;
+  NRF_TIMER2->EVENTS_COMPARE[0] = 0;
+  NRF_TIMER2->INTENSET = TIMER_INTENSET_COMPARE0_Msk;
+  NRF_TIMER2->TASKS_CLEAR = 1;
+  NRF_TIMER2->TASKS_START = 1;
+
+  /* Flicker edge latches RTC tick count and is counted */
+  NRF_PPI->CH[6].EEP = (uint32_t)&NRF_GPIOTE->EVENTS_PORT;
+  NRF_PPI->CH[6].TEP = (uint32_t)&NRF_TIMER1->TASKS_CAPTURE[0];
+  NRF_PPI->FORK[6].TEP = (uint32_t)&NRF_TIMER2->TASKS_COUNT;
+
+  /* End of flync period latches RTC tick count */
+  NRF_PPI->CH[7].EEP = (uint32_t)&NRF_RTC0->EVENTS_COMPARE[1];
+  NRF_PPI->CH[7].TEP = (uint32_t)&NRF_TIMER1->TASKS_CAPTURE[1];
+
+  NRF_PPI->CHENSET =
+      PPI_CHENSET_CH5_Msk | PPI_CHENSET_CH6_Msk | PPI_CHENSET_CH7_Msk;
+
+  NVIC_ClearPendingIRQ(TIMER2_IRQn);
+  NVIC_EnableIRQ(TIMER2_IRQn);
+  return 0;
+}
+#endif
+
+/* Matches a period in RTC ticks to a flicker rate with the tolerance the PLL
+ * applies to frequency samples */
+static unsigned int flync_detect(unsigned int period) {
+  return pll_rate((int32_t)period << PLL_FRAC_BITS);
+}
+
+#if FLYNC_ACTIVE
+static void flync_wait_edge(void) {
+  while (NRF_GPIOTE->EVENTS_IN[0] == 0) {
+    __WFE();
+    __SEV();
+    __WFE();
+  };
+  NRF_GPIOTE->EVENTS_IN[0] = 0;
+  NVIC_ClearPendingIRQ(GPIOTE_IRQn);
+}
+#endif
+
 int flync_init(unsigned int gpio_pin) {
 
   if (gpio_pin < FLYNC_NO_GPIO)
     flync_setup_gpio(gpio_pin);
 
-  /* Discharge capacitor to guarantee current flow and clock signal */
-  cap_discharge(V2ADC(V_INIT_TRGT));
+  /* Period and integrator from before brownout can skip calibration */
+  warmboot_state_t *warm_state = warmboot_state();
+  bool warm = (warmboot_source() != WARMBOOT_COLD) &&
+              (flync_detect(warm_state->period) > 0);
+
+  /* Discharge capacitor to guarantee current flow and clock signal. Only a
+   * brownout with retained RAM leaves the capacitor far from overvoltage,
+   * after a power loss it may have charged up to any level. */
+  if (!warm || (warmboot_source() != WARMBOOT_RAM))
+    cap_discharge(V2ADC(V_INIT_TRGT));
 
 #if FLYNC_ACTIVE
 
@@ -92,22 +171,34 @@ int flync_init(unsigned int gpio_pin) {
   /* Allow pending interrupts to wakeup CPU */
   SCB->SCR |= SCB_SCR_SEVONPEND_Msk;
 
-  /* Wait for two rising edges */
-  for (unsigned int i = 0; i < 2; i++) {
-
+  /* Wait for a rising edge to align the phase. On cold boot, measure the
+   * average period over the following edges to detect the flicker rate. */
+  unsigned int period = RTC_FREQUENCY / FLYNC_CLOCK_FREQ_DEFAULT;
+  for (unsigned int attempt = 0; attempt < FLYNC_CAL_ATTEMPTS; attempt++) {
+    flync_wait_edge();
     NRF_RTC0->TASKS_CLEAR = 1;
-
-    while (NRF_GPIOTE->EVENTS_IN[0] == 0) {
-      __WFE();
-      __SEV();
-      __WFE();
-    };
-    NRF_GPIOTE->EVENTS_IN[0] = 0;
-    NVIC_ClearPendingIRQ(GPIOTE_IRQn);
+    if (warm)
+      break;
+
+    for (unsigned int i = 0; i < FLYNC_CAL_PERIODS; i++)
+      flync_wait_edge();
+    unsigned int measured =
+        (NRF_RTC0->COUNTER + FLYNC_CAL_PERIODS / 2) / FLYNC_CAL_PERIODS;
+
+    /* Missed or spurious edges give a period matching neither rate */
+    if (flync_detect(measured) > 0) {
+      period = measured;
+      break;
+    }
   }
 
-  /* Current counter value should be exactly one flync period */
-  FLYNC_PERIOD_REG = NRF_RTC0->COUNTER;
+  if (warm) {
+    FLYNC_PERIOD_REG = warm_state->period;
+    pll_init(&pll, warm_state->period, warm_state->freq, FLYNC_PLL_DECIM);
+  } else {
+    FLYNC_PERIOD_REG = period;
+    pll_init(&pll, period, 0, FLYNC_PLL_DECIM);
+  }
   NRF_RTC0->TASKS_CLEAR = 1;
 
   /* Disable pending interrupts to wakeup CPU */
@@ -122,8 +213,12 @@ int flync_init(unsigned int gpio_pin) {
                            NRF_GPIO_PIN_SENSE_LOW);
 
   NRF_GPIOTE->EVENTS_PORT = 0;
+#if FLYNC_HW_CAPTURE
+  flync_setup_capture();
+#else
   NRF_GPIOTE->INTENSET = GPIOTE_INTENSET_PORT_Msk;
   NVIC_EnableIRQ(GPIOTE_IRQn);
+#endif
 
 #else
   /* Configure RTC for 1ms interrupt */
@@ -139,12 +234,69 @@ int flync_init(unsigned int gpio_pin) {
   return 0;
 }
 
+#if FLYNC_HW_CAPTURE
+__attribute__((long_call, section(".ramfunctions"))) static inline void
+flync_edge_captured(void) {
+  /* Wakes up only every pll.decim flicker edges. Edges and period boundaries
+   * have been timestamped by TIMER1 in hardware, so that the difference of
+   * the two captures is the RTC counter value at the last edge. Edges missing
+   * during MPPT phases only delay the next update, spurious edges are
+   * rejected by the PLL and ignored during learned MPPT gaps, where the RTC
+   * free-runs on the estimated period.
+   */
+  if (NRF_TIMER2->EVENTS_COMPARE[0] == 1) {
+    NRF_TIMER2->EVENTS_COMPARE[0] = 0;
+    n_edges += NRF_TIMER2->CC[0];
+
+    unsigned int now = timer_now();
+    unsigned int period = FLYNC_PERIOD_REG;
+    unsigned int phase = NRF_TIMER1->CC[0] - NRF_TIMER1->CC[1];
+    /* Period boundary right after edge, before we got to read the captures */
+    if ((int)phase < 0)
+      phase += period;
+
+    if (pll_holdover(&pll, now))
+      return;
+
+    period = pll_update(&pll, phase, now - t_last_update, n_edges, now);
+    if (period == 0)
+      return;
+
+    FLYNC_PERIOD_REG = period;
+    t_last_update = now;
+    n_edges = 0;
+    /* Number of edges until next update */
+    NRF_TIMER2->CC[0] = pll.decim;
+
+    /* Wake up on every tick to free-run through the next MPPT gap */
+    if (pll_holdover(&pll, now + 2 * pll.decim)) {
+      NRF_RTC0->EVENTS_COMPARE[1] = 0;
+      NRF_RTC0->INTENSET = RTC_INTENSET_COMPARE1_Msk;
+    }
+  }
+}
+
 __attribute__((long_call, section(".ramfunctions"))) void
-GPIOTE_IRQHandler(void) {
+TIMER2_IRQHandler(void) {
+  trace_begin(TRACE_EDGE_IRQ);
+  flync_edge_captured();
+  trace_end(TRACE_EDGE_IRQ);
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void _flync_tick(void) {
+  unsigned int now = timer_now();
+  if (pll_holdover(&pll, now))
+    FLYNC_PERIOD_REG = pll_freerun(&pll);
+  else if (!pll_holdover(&pll, now + 2 * pll.decim))
+    NRF_RTC0->INTENCLR = RTC_INTENCLR_COMPARE1_Msk;
+}
+#else
+__attribute__((long_call, section(".ramfunctions"))) static inline void
+flync_edge_detected(void) {
   /* This handles the GPIO interrupt from the flync circuit. It should trigger
    * on every falling edge of the flync clock signal. We timestamp the
-   * on-board RTC timer and run a PI control pased PLL to synchronize the
-   * RTC to the external clock signal.
+   * on-board RTC timer and run the PLL to synchronize the RTC to the external
+   * clock signal.
    */
   if (NRF_GPIOTE->EVENTS_PORT == 1) {
     NRF_GPIOTE->EVENTS_PORT = 0;
@@ -154,23 +306,32 @@ GPIOTE_IRQHandler(void) {
       return;
     }
 
-    /* Check if counter has reasonable value, else this may be spurious edge */
-    if ((NRF_RTC0->COUNTER > FLYNC_CLOCK_RTCTICKS * 3 / 4) ||
-        (NRF_RTC0->COUNTER < FLYNC_CLOCK_RTCTICKS / 4)) {
-      return;
-    }
     // NRF_P0->OUTSET = (1 << FLYNC_PIN_DBG2);
 
-    /* Calculate clock correction using PI control loop */
-    int correction = pi_control(NRF_RTC0->COUNTER, FLYNC_PERIOD_REG);
+    /* PLL rejects edges with unreasonable phase */
+    unsigned int now = timer_now();
+    unsigned int period = pll_update(&pll, NRF_RTC0->COUNTER,
+                                     now - t_last_update, ++n_edges, now);
+    if (period == 0)
+      return;
+
     /* Update flync period register (and thereby timer period) */
-    FLYNC_PERIOD_REG = FLYNC_CLOCK_RTCTICKS + correction;
+    FLYNC_PERIOD_REG = period;
+    t_last_update = now;
+    n_edges = 0;
 
     clock_edge_detected = true;
     // NRF_P0->OUTCLR = (1 << FLYNC_PIN_DBG2);
   }
 }
 
+__attribute__((long_call, section(".ramfunctions"))) void
+GPIOTE_IRQHandler(void) {
+  trace_begin(TRACE_EDGE_IRQ);
+  flync_edge_detected();
+  trace_end(TRACE_EDGE_IRQ);
+}
+
 __attribute__((long_call, section(".ramfunctions"))) void
 SAADC_IRQHandler(void) {
 /*
@@ -180,32 +341,27 @@ SAADC_IRQHandler(void) {
  * reading, potentially informing the application if it crosses a turn-on
  * threshold.
  */
-#if FLYNC_ACTIVE
-  static unsigned int mppt_countdown = 0;
-#endif
   if (NRF_SAADC->EVENTS_END == 1) {
     NRF_SAADC->EVENTS_END = 0;
 
 #if FLYNC_ACTIVE
-    /* Are we currently in MPPT phase? */
-    if (mppt_countdown) {
-      /* Re-enable gpio interrupt, if we've waited for long enough */
-      if (--mppt_countdown == 0) {
-        NVIC_ClearPendingIRQ(GPIOTE_IRQn);
-        NRF_GPIOTE->INTENSET = GPIOTE_INTENSET_PORT_Msk;
-      }
-    }
-    /* Assume that we're in MPPT phase, when there's been no gpio interrupt */
-    else if (!clock_edge_detected) {
-      /* Disable the GPIOTE interrupt for MPPT phase */
+    /* Edges are missing or spurious during predicted MPPT phase */
+    if (pll_holdover(&pll, timer_now() + 1)) {
       NRF_GPIOTE->EVENTS_PORT = 0;
       NRF_GPIOTE->INTENCLR = GPIOTE_INTENCLR_PORT_Msk;
-      mppt_countdown = 28;
+    } else if ((NRF_GPIOTE->INTENSET & GPIOTE_INTENSET_PORT_Msk) == 0) {
+      NVIC_ClearPendingIRQ(GPIOTE_IRQn);
+      NRF_GPIOTE->INTENSET = GPIOTE_INTENSET_PORT_Msk;
     }
+    /* Free-run on estimated frequency, when there's been no edge */
+    if (!clock_edge_detected)
+      FLYNC_PERIOD_REG = pll_freerun(&pll);
     clock_edge_detected = false;
 #endif
 
     /* Update system timer */
     _timer_tick();
   }
+  _charge_limit();
 }
+#endif
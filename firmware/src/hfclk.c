@@ -0,0 +1,44 @@
+#include <stdint.h>
+
+#include "hfclk.h"
+#include "warmboot.h"
+
+#define HFCLK_MAGIC 0x4FC1C4FCUL
+
+static hfclk_state_t state __attribute__((section(".noinit")));
+
+int hfclk_init(void) {
+  if (state.latency > (HFCLK_LEAD_MAX << HFCLK_FRAC_BITS))
+    state.magic = 0;
+  if (!retained_init(&state, sizeof(state), HFCLK_MAGIC))
+    return 0;
+
+  state.latency = (HFCLK_LEAD_MAX - HFCLK_GUARD_TCKS) << HFCLK_FRAC_BITS;
+  return 1;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void
+hfclk_update(unsigned int latency_tcks) {
+  if (latency_tcks > HFCLK_LEAD_MAX)
+    latency_tcks = HFCLK_LEAD_MAX;
+
+  state.n++;
+  if (latency_tcks >= hfclk_lead())
+    state.late++;
+
+  uint32_t sample = latency_tcks << HFCLK_FRAC_BITS;
+  if (sample >= state.latency)
+    state.latency = sample;
+  else
+    state.latency -= (state.latency - sample) >> HFCLK_DECAY_SHIFT;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+hfclk_lead(void) {
+  unsigned int lead =
+      ((state.latency + (1 << HFCLK_FRAC_BITS) - 1) >> HFCLK_FRAC_BITS) +
+      HFCLK_GUARD_TCKS;
+  return (lead < HFCLK_LEAD_MAX) ? lead : HFCLK_LEAD_MAX;
+}
+
+const hfclk_state_t *hfclk_stats(void) { return &state; }
@@ -0,0 +1,46 @@
+#include <stdint.h>
+
+#include "hop.h"
+#include "prng.h"
+
+_Static_assert((HOP_N_CHANNELS >= 1) && (HOP_N_CHANNELS <= 3),
+               "only three channels are defined");
+
+static const uint8_t channels[] = HOP_CHANNELS;
+
+/* Offset of the own hop sequence from the system time */
+static uint16_t hop_offset;
+
+/*
+ * Scrambles the slot counter, so that sequences of different offsets are
+ * uncorrelated. Must match hop_mix in model/neslab/find/sim.py.
+ */
+__attribute__((long_call, section(".ramfunctions"))) static uint32_t
+hop_mix(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x7FEB352DUL;
+  x ^= x >> 15;
+  x *= 0x846CA68BUL;
+  x ^= x >> 16;
+  return x;
+}
+
+int hop_init(void) {
+  hop_offset = prng_urand(0, UINT16_MAX);
+  return 0;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) uint16_t
+hop_slot(uint32_t now) {
+  return (uint16_t)(now + hop_offset);
+}
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+hop_channel(uint16_t slot) {
+  return channels[hop_mix(slot) % HOP_N_CHANNELS];
+}
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+hop_meet_channel(void) {
+  return channels[0];
+}
@@ -0,0 +1,170 @@
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef LOG_HOST
+#include "nrf52840.h"
+#include "nrf52840_bitfields.h"
+#include "nrf_uart.h"
+#endif
+
+#include "log.h"
+#include "timer.h"
+
+#define LOG_BUF_MASK (LOG_BUF_WORDS - 1)
+
+/* Records are read by EasyDMA, which can only access data RAM */
+static uint32_t log_buf[LOG_BUF_WORDS];
+/* Free running word indices, masked on access */
+static volatile unsigned int log_w = 0;
+static volatile unsigned int log_r = 0;
+
+/* Number of records dropped since the last dropped-record was written */
+static unsigned int log_dropped = 0;
+
+#ifdef LOG_HOST
+static uint32_t host_now;
+
+void log_host_clock(uint32_t now) { host_now = now; }
+
+unsigned int log_host_read(uint32_t *words, unsigned int max) {
+  unsigned int n = 0;
+  while ((n < max) && (log_r != log_w))
+    words[n++] = log_buf[log_r++ & LOG_BUF_MASK];
+  return n;
+}
+
+#define log_now() host_now
+#define log_lock() 0
+#define log_unlock(primask) (void)(primask)
+#else
+#define log_now() timer_now()
+
+/* Words in the current DMA transfer, 0 while idle */
+static volatile unsigned int log_dma_words = 0;
+/* Keep transferring chunks until the ring is empty */
+static volatile bool log_draining = false;
+static bool log_ready = false;
+
+static inline uint32_t log_lock(void) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  return primask;
+}
+
+#define log_unlock(primask) __set_PRIMASK(primask)
+#endif
+
+__attribute__((long_call, section(".ramfunctions"))) static void
+log_put(uint32_t word) {
+  log_buf[log_w & LOG_BUF_MASK] = word;
+  log_w++;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void
+_log_write(uint32_t id, unsigned int nargs, ...) {
+  va_list args;
+  va_start(args, nargs);
+
+  /* Interrupt handlers log too, records must not interleave */
+  uint32_t primask = log_lock();
+
+  unsigned int free = LOG_BUF_WORDS - (log_w - log_r);
+  unsigned int need = 2 + nargs + ((log_dropped > 0) ? 3 : 0);
+  if (need > free) {
+    log_dropped++;
+  } else {
+    uint32_t now = log_now();
+    if (log_dropped > 0) {
+      log_put(LOG_HEADER(LOG_ID_DROPPED, 1));
+      log_put(now);
+      log_put(log_dropped);
+      log_dropped = 0;
+    }
+    log_put(LOG_HEADER(id, nargs));
+    log_put(now);
+    for (unsigned int i = 0; i < nargs; i++)
+      log_put(va_arg(args, uint32_t));
+  }
+
+  log_unlock(primask);
+  va_end(args);
+}
+
+#ifndef LOG_HOST
+/* Transfers the oldest contiguous chunk of the ring, must not be interrupted */
+__attribute__((long_call, section(".ramfunctions"))) static void
+log_dma_start(void) {
+  unsigned int r = log_r & LOG_BUF_MASK;
+  unsigned int n = log_w - log_r;
+  /* DMA cannot wrap around the end of the ring */
+  if (n > LOG_BUF_WORDS - r)
+    n = LOG_BUF_WORDS - r;
+  if (n == 0) {
+    log_draining = false;
+    return;
+  }
+
+  log_dma_words = n;
+  NRF_UARTE0->TXD.PTR = (uint32_t)&log_buf[r];
+  NRF_UARTE0->TXD.MAXCNT = n * sizeof(uint32_t);
+  NRF_UARTE0->EVENTS_ENDTX = 0;
+  NRF_UARTE0->TASKS_STARTTX = 1;
+}
+
+int log_init(uint32_t pseltxd) {
+  NRF_UARTE0->PSEL.TXD = pseltxd;
+  /* Disconnect RX, CTS and RTS pins */
+  NRF_UARTE0->PSEL.RXD = (1UL << 31);
+  NRF_UARTE0->PSEL.CTS = (1UL << 31);
+  NRF_UARTE0->PSEL.RTS = (1UL << 31);
+  NRF_UARTE0->BAUDRATE = UARTE_BAUDRATE_BAUDRATE_Baud1M;
+  NRF_UARTE0->CONFIG = 0;
+  NRF_UARTE0->ENABLE = UARTE_ENABLE_ENABLE_Enabled;
+
+  NRF_UARTE0->INTENSET = UARTE_INTENSET_ENDTX_Msk;
+  NVIC_ClearPendingIRQ(UARTE0_UART0_IRQn);
+  NVIC_EnableIRQ(UARTE0_UART0_IRQn);
+
+  log_ready = true;
+  return 0;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void log_drain(void) {
+  if (!log_ready)
+    return;
+
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  log_draining = true;
+  if (log_dma_words == 0)
+    log_dma_start();
+  __set_PRIMASK(primask);
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void log_stop(void) {
+  log_draining = false;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+log_pending(void) {
+  return log_w - log_r;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void
+UARTE0_UART0_IRQHandler(void) {
+  if (NRF_UARTE0->EVENTS_ENDTX == 1) {
+    NRF_UARTE0->EVENTS_ENDTX = 0;
+
+    /* Hand the transferred words back to the writers */
+    log_r += log_dma_words;
+    log_dma_words = 0;
+
+    if (log_draining)
+      log_dma_start();
+    /* Transmitter keeps HFCLK requested until it is stopped */
+    if (log_dma_words == 0)
+      NRF_UARTE0->TASKS_STOPTX = 1;
+  }
+}
+#endif
@@ -14,17 +14,91 @@
 #include "nrf_saadc.h"
 #include "nrf_uart.h"
 
+#include "acct.h"
+#include "charge.h"
+#include "density.h"
 #include "flync.h"
+#include "hfclk.h"
+#include "hop.h"
+#include "log.h"
+#include "neighbor.h"
 #include "printf.h"
+#include "rxwdw.h"
+#include "scheduler.h"
+#include "trace.h"
+#include "txpwr.h"
+#include "vthr.h"
+#include "warmboot.h"
 
 /* Minimum voltage for becoming active */
 #define V_THR_ON 3.3
+/* Adapt the turn-on threshold to the energy needed by the first round,
+ * starting from V_THR_ON */
+#define FIND_ADAPTIVE_THR_ON 0
+/* Highest adaptive turn-on threshold */
+#define V_THR_ON_MAX 3.45
 /* Power off threshold */
 #define V_THR_OFF NRF_POWER_POFTHR_V27
 
 /* Maximum voltage before converter goes into overvoltage protection mode */
 #define V_THR_MAX 3.5
 
+/* Use energy left after discovery for additional rounds */
+#define FIND_EXTRA_ROUNDS 1
+/* Minimum voltage for another full discovery round */
+#define V_THR_ROUND 3.0
+/* SAADC conversion started on a flync tick is done after this many RTC ticks.
+ * Waited for relative to the wakeup, must exceed TIMER_RTC_MIN_TICKS, as
+ * closer timers fire right away. */
+#define ADC_CONV_TCKS 3
+
+/* RX window margin in RTC ticks, the window adds the airtime of two packets */
+#define RX_WDW_TCKS 22
+/* Choose the margin from the capacitor voltage before every round, with
+ * RX_WDW_TCKS as the shortest one */
+#define FIND_ADAPTIVE_RX_WDW 1
+/* Close RX window after this many valid packets, 0 to listen full window */
+#define RX_EXIT_PKTS 1
+
+/**
+ * Adds nodes discovered in previous round to neighbor table
+ *
+ * Plans a meeting with every discovered node.
+ *
+ * @param t_next Own next planned wakeup advertised in the round
+ * @param t_chr Own charging time advertised in the round
+ *
+ * @returns Number of received packets
+ */
+__attribute__((long_call, section(".ramfunctions"))) static unsigned int
+handle_results(uint32_t t_next, uint16_t t_chr) {
+  disco_data_t *disco_data;
+  nbr_entry_t *entry;
+  unsigned int n_results = 0;
+
+  while ((disco_data = disco_results_pop()) != NULL) {
+    entry =
+        nbr_update(disco_data->device_id, disco_data->rssi, disco_data->t_chr);
+    nbr_schedule(entry, t_next, disco_data->t_next, t_chr);
+    txpwr_update(entry, disco_data->rssi, disco_data->tx_power);
+#if DISCO_GOSSIP_IDS > 0
+    nbr_gossip(entry, disco_data->gossip, DISCO_GOSSIP_IDS,
+               NRF_FICR->DEVICEADDR[0]);
+    for (unsigned int i = 0; i < NBR_TWO_HOP; i++) {
+      if (entry->two_hop[i] != 0)
+        log_printf("gossip %08X hears %04X\n", disco_data->device_id,
+                   entry->two_hop[i]);
+    }
+#endif
+    log_printf("disco %08X type %u rssi %u t_chr %u\n", disco_data->device_id,
+               disco_data->type, disco_data->rssi, disco_data->t_chr);
+    /* Switch on LED */
+    NRF_P0->OUTSET = (1 << FLYNC_LED);
+    n_results++;
+  }
+  return n_results;
+}
+
 /**
  * Protocol protothread
  *
@@ -40,50 +114,168 @@ protocol(struct pt *pt) {
   pt_begin(pt);
 
   static struct pt pt_disco_h;
+  static timer_handle_t clk_timer;
   static volatile pt_event_t *clk_evt;
   static volatile pt_event_t *pof_evt;
-
-  static disco_data_t *disco_data;
+  static volatile pt_event_t *chg_evt;
 
   static unsigned int t_start;
   static unsigned int t_charge;
+  static unsigned int n_rounds;
+  static unsigned int n_heard;
+  static unsigned int rx_wdw;
+  static unsigned int v_disco;
+  static uint32_t t_meet;
+  static uint32_t t_next;
+  static bool meet;
 
   for (;;) {
     /* Timestamp beginning of charging period */
     t_start = timer_now();
 
-    /* Make sure next reading from ADC is recent */
-    pt_yield(pt);
-
     /* Wait until voltage reaches turn-on threshold */
-    pt_wait(pt, adc_read_vcap() > V2ADC(V_THR_ON));
+#if FIND_ADAPTIVE_THR_ON
+    chg_evt = charge_above(vthr_get());
+#else
+    chg_evt = charge_above(V2ADC(V_THR_ON));
+#endif
+    sched_wait(pt, SCHED_EVT_CHARGE, pt_event_get(chg_evt));
     t_charge = timer_now() - t_start;
+    acct_enter(ACCT_WAIT);
+    /* The capacitor wasn't full for long, spend some of the turn-on energy */
+    warmboot_nvm_update(2 * WARMBOOT_NVM_INTERVAL);
 
-    /* Maximum waiting time equals charging time*/
-    unsigned int wait_time = geometric_itf_sample(lookup_scale(t_charge));
+    /* Wake up for a meeting with known neighbors, if one is planned */
+    unsigned int wait_time;
+    uint32_t now = timer_now();
+    meet = (nbr_meeting(now, &t_meet) == 0);
+    if (meet)
+      wait_time = t_meet - now - 1;
+    else
+      /* Maximum waiting time equals charging time*/
+      wait_time =
+          geometric_itf_sample(lookup_scale(t_charge, density_get()));
 
     /* Wait for waiting time or until capacitor is fully charged */
-    clk_evt = timer_flync_wait(wait_time);
-    pt_wait(pt, pt_event_get(clk_evt) || (adc_read_vcap() > V2ADC(V_THR_MAX)));
+    clk_evt = timer_flync_wait(&clk_timer, wait_time);
+    chg_evt = charge_above(V2ADC(V_THR_MAX));
+    sched_wait(pt, SCHED_EVT_TIMER | SCHED_EVT_CHARGE,
+               pt_event_get(clk_evt) || pt_event_get(chg_evt));
+    /* Energy beyond the full capacitor would be wasted, spend it on the log
+     * and on the NVM record */
+    if (pt_event_get(chg_evt)) {
+      warmboot_nvm_update(WARMBOOT_NVM_INTERVAL);
+      log_drain();
+    }
+    /* Neighbors only wake up at the planned slot */
+    if (meet)
+      sched_wait(pt, SCHED_EVT_TIMER, pt_event_get(clk_evt));
+    timer_cancel(&clk_timer);
+    charge_cancel();
+    acct_enter(ACCT_DISCO);
 
+    /* Discovery waits on radio events and its RX window timer */
+    /* Advertise the next wakeup, so that discovered nodes can meet again */
+    t_next = nbr_plan(timer_now(), (uint16_t)t_charge);
+    /* Conversion of the last tick measured the voltage left after waiting */
+    v_disco = adc_read_vcap();
+#if FIND_ADAPTIVE_RX_WDW
+    rx_wdw = rxwdw_select(v_disco, RX_WDW_TCKS);
+#else
+    rx_wdw = RX_WDW_TCKS;
+#endif
+    sched_block(SCHED_EVT_RADIO | SCHED_EVT_TIMER);
 #if FLYNC_ACTIVE
-    pt_disco(pt, &pt_disco_h, (uint16_t)t_charge, 26, flync_phase2rtctcks(1));
+    pt_disco(pt, &pt_disco_h, (uint16_t)t_charge, t_next, rx_wdw,
+             flync_phase2rtctcks(1), RX_EXIT_PKTS, meet);
 #else
-    pt_disco(pt, &pt_disco_h, (uint16_t)t_charge, 26, 0);
+    pt_disco(pt, &pt_disco_h, (uint16_t)t_charge, t_next, rx_wdw, 0,
+             RX_EXIT_PKTS, meet);
 #endif
     pof_evt = pofwarn_request_evt(V_THR_OFF);
+    n_rounds = 1;
 
-    while ((disco_data = disco_results_pop()) != NULL) {
-      /* Switch on LED */
-      NRF_P0->OUTSET = (1 << FLYNC_LED);
-    }
+    /* Age neighbors by one cycle and add the ones discovered in this round */
+    nbr_age();
+    n_heard = handle_results(t_next, (uint16_t)t_charge);
+
+#if FIND_EXTRA_ROUNDS
+    /* Instead of burning the remaining charge, discover on following periods
+     * for as long as the capacitor holds enough energy for a full round */
+    chg_evt = charge_below(V2ADC(V_THR_ROUND));
+    for (;;) {
+      clk_evt = timer_flync_wait(&clk_timer, 0);
+      sched_wait(pt, SCHED_EVT_TIMER | SCHED_EVT_POFWARN | SCHED_EVT_CHARGE,
+                 pt_event_get(clk_evt) || pt_event_get(pof_evt) ||
+                     pt_event_get(chg_evt));
+      if (pt_event_get(pof_evt) || pt_event_get(chg_evt))
+        break;
+
+      /* Give the conversion on this tick a chance to cross the threshold */
+      clk_evt = timer_rtc_wait(&clk_timer, ADC_CONV_TCKS);
+      sched_wait(pt, SCHED_EVT_TIMER | SCHED_EVT_POFWARN | SCHED_EVT_CHARGE,
+                 pt_event_get(clk_evt) || pt_event_get(pof_evt) ||
+                     pt_event_get(chg_evt));
+      if (pt_event_get(pof_evt) || pt_event_get(chg_evt))
+        break;
 
-    while (!pt_event_get(pof_evt)) {
-      __NOP();
+#if FIND_ADAPTIVE_RX_WDW
+      rx_wdw = rxwdw_select(adc_read_vcap(), RX_WDW_TCKS);
+#endif
+      sched_block(SCHED_EVT_RADIO | SCHED_EVT_TIMER);
+#if FLYNC_ACTIVE
+      pt_disco(pt, &pt_disco_h, (uint16_t)t_charge, t_next, rx_wdw,
+               flync_phase2rtctcks(1), RX_EXIT_PKTS, false);
+#else
+      pt_disco(pt, &pt_disco_h, (uint16_t)t_charge, t_next, rx_wdw, 0,
+               RX_EXIT_PKTS, false);
+#endif
+      n_rounds++;
+      n_heard += handle_results(t_next, (uint16_t)t_charge);
+      wdt_reload();
     }
+    timer_cancel(&clk_timer);
+    charge_cancel();
+#endif
+    acct_enter(ACCT_POF);
+    /* Leave the remaining charge to discovery and the warm boot record */
+    log_stop();
+    log_printf("cycle t_chr %u rounds %u meet %u\n", t_charge, n_rounds,
+               meet);
+
+    /* Update density estimate with packets heard in this cycle */
+    density_update(timer_now() - t_start, n_rounds);
+    /* Lowest TX power that reaches recent neighbors, more if none was heard */
+    radio_set_txpower(txpwr_adapt(n_heard));
+    log_printf("txpwr %d heard %u\n", radio_txpower(), n_heard);
+    log_printf("hfclk lead %u late %u\n", hfclk_lead(), hfclk_stats()->late);
+#if FIND_ADAPTIVE_THR_ON
+    /* Charge less as long as the first round finds enough energy */
+    vthr_adapt(v_disco);
+    log_printf("thr_on %u v_disco %u\n", vthr_get(), v_disco);
+#endif
+
+    /* Sleep down to the power-fail warning instead of burning the charge.
+     * If harvesting outweighs sleeping, the warning never comes, so the cycle
+     * also ends once the capacitor recovered another round. */
+    chg_evt = charge_above(V2ADC(V_THR_ROUND));
+    sched_wait(pt, SCHED_EVT_POFWARN | SCHED_EVT_CHARGE,
+               pt_event_get(pof_evt) || pt_event_get(chg_evt));
+    charge_cancel();
+    /* Power-fail warning completes the cycle, the reset may follow */
+    acct_enter(ACCT_CHARGE);
     /* Switch off LED */
     NRF_P0->OUTCLR = (1 << FLYNC_LED);
 
+    /* Keep state for a warm boot after the upcoming brownout, without
+     * writing flash on the remaining charge */
+    flync_save(&warmboot_state()->period, &warmboot_state()->freq);
+    prng_save(warmboot_state()->prng);
+    warmboot_save();
+
+    /* Survived the power-fail warning, the next cycle starts charging */
+    acct_report();
+
     wdt_reload();
   }
   pt_end(pt);
@@ -92,15 +284,12 @@ protocol(struct pt *pt) {
 /**
  * Protothread loop
  *
- * Iterates all threads and enters low power mode when all blocking.
+ * Resumes threads whose events were notified and enters low power mode when
+ * none is ready.
  *
  */
 __attribute__((long_call, section(".ramfunctions"))) void thread_loop(void) {
-  struct pt pt_protocol = pt_init();
-  while (1) {
-    protocol(&pt_protocol);
-    enter_low_power();
-  };
+  sched_run();
 }
 
 int main(void) {
@@ -111,20 +300,55 @@ int main(void) {
 
   nrf_gpio_pin_clear(FLYNC_LED);
 
-  // uart_init(FLYNC_PIN_DBG1);
+  log_init(FLYNC_PIN_DBG1);
+#if TRACE_ENABLED
+  trace_init();
+#endif
 
   /* DC/DC reduces power consumption at high current draw */
   nrf_power_dcdcen_set(true);
   adc_init();
-  prng_seed();
+  charge_init();
+
+  if (warmboot_source() == WARMBOOT_COLD) {
+    prng_seed();
+    /* Make room for warm boot records while energy is abundant */
+    warmboot_nvm_prepare();
+  } else
+    prng_restore(warmboot_state()->prng);
+  hop_init();
+
+  /* Recover density estimate and neighbors from before brownout */
+  density_init();
+  nbr_init();
 
   /* Use device address as beacon/ack payload */
   disco_init(RADIO_NO_GPIO);
+  /* Keep TX power selected before brownout */
+  txpwr_init();
+  radio_set_txpower(txpwr_get());
+  /* Keep HFCLK startup latency measured before brownout */
+  hfclk_init();
+  timer_init();
   flync_init(FLYNC_PIN_DBG2);
+#if TRACE_ENABLED
+  trace_period(flync_period());
+#endif
+  /* Phases are timestamped with system time and RTC */
+  acct_init();
+  /* Keep turn-on threshold selected before brownout */
+  vthr_init(V2ADC(V_THR_ON), V2ADC(V_THR_ROUND), V2ADC(V_THR_ON_MAX));
+#if FIND_ADAPTIVE_THR_ON
+  /* Charge more if the last cycle browned out before the warning */
+  vthr_backoff(acct_stats()->phases[ACCT_WAIT].brownouts +
+               acct_stats()->phases[ACCT_DISCO].brownouts);
+#endif
 
   /* 5 seconds watch dog */
   wdt_init(5);
 
+  sched_add(protocol);
+
   /* From now on, we will run in RAM */
   volatile uint32_t ramfunc = (uint32_t)thread_loop;
   asm("ldr pc, [%[addr], #0]\t\n" : : [addr] "r"(&ramfunc));
@@ -0,0 +1,219 @@
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "neighbor.h"
+#include "warmboot.h"
+
+#define NBR_MAGIC 0x4E424F53UL
+
+typedef struct {
+  uint32_t magic;
+  /* Table clock in charging cycles */
+  uint32_t now;
+  nbr_entry_t entries[NBR_CAPACITY];
+} nbr_table_t;
+
+static nbr_table_t table __attribute__((section(".noinit")));
+
+__attribute__((long_call, section(".ramfunctions"))) static inline unsigned int
+nbr_hash(uint32_t device_id) {
+  /* Multiplicative hashing, NBR_CAPACITY is a power of two */
+  return (device_id * 2654435761UL) & (NBR_CAPACITY - 1);
+}
+
+__attribute__((long_call, section(".ramfunctions"))) static inline int
+nbr_valid(const nbr_entry_t *entry) {
+  return (entry->device_id != 0) &&
+         (table.now - entry->last_seen <= NBR_MAX_AGE);
+}
+
+int nbr_init(void) {
+  if (retained_init(&table, sizeof(table), NBR_MAGIC))
+    return 1;
+
+  for (unsigned int i = 0; i < NBR_CAPACITY; i++)
+    table.entries[i].meet_left = 0;
+  return 0;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void nbr_age(void) {
+  table.now++;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) uint32_t nbr_now(void) {
+  return table.now;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) nbr_entry_t *
+nbr_lookup(uint32_t device_id) {
+  unsigned int pos = nbr_hash(device_id);
+  for (unsigned int i = 0; i < NBR_PROBE_LEN; i++) {
+    nbr_entry_t *entry = &table.entries[(pos + i) & (NBR_CAPACITY - 1)];
+    if ((entry->device_id == device_id) && nbr_valid(entry))
+      return entry;
+  }
+  return NULL;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) nbr_entry_t *
+nbr_update(uint32_t device_id, uint8_t rssi, uint16_t t_chr) {
+  unsigned int pos = nbr_hash(device_id);
+  nbr_entry_t *victim = NULL;
+
+  for (unsigned int i = 0; i < NBR_PROBE_LEN; i++) {
+    nbr_entry_t *entry = &table.entries[(pos + i) & (NBR_CAPACITY - 1)];
+    if (!nbr_valid(entry)) {
+      /* Prefer free or expired entries */
+      if ((victim == NULL) || nbr_valid(victim))
+        victim = entry;
+      continue;
+    }
+    if (entry->device_id == device_id) {
+      /* Known neighbor, update moving average */
+      int32_t sample = rssi << NBR_RSSI_FRAC_BITS;
+      entry->rssi += (sample - (int32_t)entry->rssi) >> NBR_RSSI_SHIFT;
+      entry->last_seen = table.now;
+      entry->t_chr = t_chr;
+      return entry;
+    }
+    /* Otherwise evict the neighbor that was heard least recently */
+    if ((victim == NULL) ||
+        (nbr_valid(victim) && (table.now - entry->last_seen >
+                               table.now - victim->last_seen)))
+      victim = entry;
+  }
+
+  victim->device_id = device_id;
+  victim->last_seen = table.now;
+  victim->rssi = rssi << NBR_RSSI_FRAC_BITS;
+  victim->t_chr = t_chr;
+  victim->meet_left = 0;
+  victim->pathloss = 0;
+  memset(victim->two_hop, 0, sizeof(victim->two_hop));
+  return victim;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) uint32_t
+nbr_plan(uint32_t now, uint16_t t_chr) {
+  uint32_t t_earliest = now + t_chr;
+  uint32_t t_plan = t_earliest + (t_chr >> NBR_PLAN_SHIFT);
+  int32_t lead_min = INT32_MAX;
+
+  for (unsigned int i = 0; i < NBR_CAPACITY; i++) {
+    nbr_entry_t *entry = &table.entries[i];
+    if (!nbr_valid(entry) || (entry->meet_left == 0))
+      continue;
+    /* Earliest feasible meeting within another charging time */
+    int32_t lead = entry->t_meet - t_earliest;
+    if ((lead < 0) || (lead > t_chr) || (lead >= lead_min))
+      continue;
+    lead_min = lead;
+    t_plan = entry->t_meet;
+  }
+  return t_plan;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void
+nbr_schedule(nbr_entry_t *entry, uint32_t t_own, uint32_t t_peer,
+             uint16_t t_chr) {
+  /* Both sides compute the same meeting and interval */
+  entry->t_meet = ((int32_t)(t_peer - t_own) > 0) ? t_peer : t_own;
+  uint16_t t_max = (entry->t_chr > t_chr) ? entry->t_chr : t_chr;
+  entry->meet_intvl = t_max + (t_max >> NBR_PLAN_SHIFT);
+  entry->meet_left = NBR_MEET_RETRIES + 1;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) int
+nbr_meeting(uint32_t now, uint32_t *t_meet) {
+  int32_t lead_min = INT32_MAX;
+
+  for (unsigned int i = 0; i < NBR_CAPACITY; i++) {
+    nbr_entry_t *entry = &table.entries[i];
+    if (!nbr_valid(entry))
+      continue;
+    /* Neighbor wasn't heard at the meeting, retry one interval later */
+    while ((entry->meet_left > 0) && ((int32_t)(entry->t_meet - now) <= 0)) {
+      entry->meet_left--;
+      entry->t_meet += entry->meet_intvl;
+    }
+    if ((entry->meet_left == 0) || (entry->t_meet - now >= (uint32_t)lead_min))
+      continue;
+    lead_min = entry->t_meet - now;
+    *t_meet = entry->t_meet;
+  }
+  return (lead_min < INT32_MAX) ? 0 : -1;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) uint16_t
+nbr_short_id(uint32_t device_id) {
+  uint16_t id = (uint16_t)(device_id ^ (device_id >> 16));
+  return (id != 0) ? id : 1;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+nbr_recent(uint16_t *ids, unsigned int n) {
+  unsigned int n_ids = 0;
+  /* Selects by age and then by index, after the previously selected one */
+  uint32_t age_prev = 0;
+  unsigned int idx_prev = 0;
+
+  memset(ids, 0, n * sizeof(ids[0]));
+  while (n_ids < n) {
+    nbr_entry_t *best = NULL;
+    uint32_t age_best = UINT32_MAX;
+    for (unsigned int i = 0; i < NBR_CAPACITY; i++) {
+      nbr_entry_t *entry = &table.entries[i];
+      if (!nbr_valid(entry))
+        continue;
+      uint32_t age = table.now - entry->last_seen;
+      if ((n_ids > 0) &&
+          ((age < age_prev) || ((age == age_prev) && (i <= idx_prev))))
+        continue;
+      if (age < age_best) {
+        best = entry;
+        age_best = age;
+      }
+    }
+    if (best == NULL)
+      break;
+    age_prev = age_best;
+    idx_prev = best - table.entries;
+    ids[n_ids++] = nbr_short_id(best->device_id);
+  }
+  return n_ids;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void
+nbr_gossip(nbr_entry_t *entry, const uint16_t *ids, unsigned int n,
+           uint32_t own_id) {
+  uint16_t own = nbr_short_id(own_id);
+  unsigned int n_two_hop = 0;
+
+  memset(entry->two_hop, 0, sizeof(entry->two_hop));
+  for (unsigned int i = 0; (i < n) && (n_two_hop < NBR_TWO_HOP); i++) {
+    if ((ids[i] != 0) && (ids[i] != own))
+      entry->two_hop[n_two_hop++] = ids[i];
+  }
+}
+
+__attribute__((long_call, section(".ramfunctions"))) nbr_entry_t *
+nbr_next(unsigned int *idx) {
+  while (*idx < NBR_CAPACITY) {
+    nbr_entry_t *entry = &table.entries[(*idx)++];
+    if (nbr_valid(entry))
+      return entry;
+  }
+  return NULL;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+nbr_count(void) {
+  unsigned int count = 0;
+  for (unsigned int i = 0; i < NBR_CAPACITY; i++) {
+    if (nbr_valid(&table.entries[i]))
+      count++;
+  }
+  return count;
+}
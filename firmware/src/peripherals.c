@@ -11,10 +11,16 @@
 #include <stdint.h>
 
 #include "flync.h"
+#include "hfclk.h"
 #include "peripherals.h"
+#include "scheduler.h"
 
 static volatile pt_event_t pofwarn_evt = pt_event_init();
 
+/* RTC counter when HFCLK was started, if its startup is being measured */
+static volatile uint32_t hfclk_rtc_start;
+static volatile bool hfclk_measuring = false;
+
 __attribute__((long_call, section(".ramfunctions"))) void
 enter_low_power(void) {
   __WFE();
@@ -56,9 +62,22 @@ __attribute__((long_call, section(".ramfunctions"))) int wdt_reload(void) {
   return 0;
 }
 void POWER_CLOCK_IRQHandler(void) {
+  if (NRF_CLOCK->EVENTS_HFCLKSTARTED == 1) {
+    NRF_CLOCK->EVENTS_HFCLKSTARTED = 0;
+    NRF_CLOCK->INTENCLR = CLOCK_INTENCLR_HFCLKSTARTED_Msk;
+    if (hfclk_measuring) {
+      uint32_t rtc = NRF_RTC0->COUNTER;
+      /* RTC was cleared at a flync tick in between */
+      if (rtc < hfclk_rtc_start)
+        rtc += flync_period();
+      hfclk_update(rtc - hfclk_rtc_start);
+      hfclk_measuring = false;
+    }
+  }
   if (NRF_POWER->EVENTS_POFWARN == 1) {
     NRF_POWER->EVENTS_POFWARN = 0;
     pt_event_set(&pofwarn_evt);
+    sched_notify(SCHED_EVT_POFWARN);
     NRF_POWER->POFCON &= ~(1 << 0);
     NRF_POWER->INTENCLR = POWER_INTENCLR_POFWARN_Msk;
     NVIC_DisableIRQ(POWER_CLOCK_IRQn);
@@ -77,6 +96,24 @@ pofwarn_request_evt(nrf_power_pof_thr_t pofwarn_thr) {
   return &pofwarn_evt;
 }
 
+__attribute__((long_call, section(".ramfunctions"))) int hfclk_start(void) {
+  /* Already running, e.g. for the log, there is no startup to measure */
+  hfclk_measuring =
+      (NRF_CLOCK->HFCLKSTAT &
+       (CLOCK_HFCLKSTAT_SRC_Msk | CLOCK_HFCLKSTAT_STATE_Msk)) !=
+      ((CLOCK_HFCLKSTAT_SRC_Xtal << CLOCK_HFCLKSTAT_SRC_Pos) |
+       (CLOCK_HFCLKSTAT_STATE_Running << CLOCK_HFCLKSTAT_STATE_Pos));
+  if (hfclk_measuring) {
+    NRF_CLOCK->EVENTS_HFCLKSTARTED = 0;
+    NRF_CLOCK->INTENSET = CLOCK_INTENSET_HFCLKSTARTED_Msk;
+    NVIC_ClearPendingIRQ(POWER_CLOCK_IRQn);
+    NVIC_EnableIRQ(POWER_CLOCK_IRQn);
+    hfclk_rtc_start = NRF_RTC0->COUNTER;
+  }
+  NRF_CLOCK->TASKS_HFCLKSTART = 1;
+  return 0;
+}
+
 int pofwarn_disable(void) {
   NRF_POWER->POFCON &= ~(1 << 0);
   NRF_POWER->EVENTS_POFWARN = 0;
@@ -120,8 +157,10 @@ int adc_init() {
   NRF_PPI->CH[3].TEP = (uint32_t)&NRF_SAADC->TASKS_STOP;
   NRF_PPI->CHENSET = PPI_CHENSET_CH3_Msk;
 
+#if !FLYNC_HW_CAPTURE
   NRF_SAADC->INTENSET = SAADC_INTENSET_END_Msk;
   NVIC_EnableIRQ(SAADC_IRQn);
+#endif
   return 0;
 }
 
@@ -138,7 +177,9 @@ cap_discharge(unsigned int v_level) {
   }
   NRF_SAADC->EVENTS_END = 0;
   NVIC_ClearPendingIRQ(SAADC_IRQn);
+#if !FLYNC_HW_CAPTURE
   NRF_SAADC->INTENSET = SAADC_INTENSET_END_Msk;
+#endif
 
   return 0;
 }
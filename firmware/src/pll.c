@@ -0,0 +1,186 @@
+#include <stdint.h>
+
+#include "pll.h"
+#include "trace.h"
+
+#define PLL_ONE (1L << PLL_FRAC_BITS)
+
+__attribute__((long_call, section(".ramfunctions"))) static unsigned int
+pll_round(pll_t *pll, int32_t period) {
+  /* Carry rounding residual over, so that the average period is exact */
+  period += pll->frac;
+  unsigned int rounded = (period + PLL_ONE / 2) >> PLL_FRAC_BITS;
+  pll->frac = period - ((int32_t)rounded << PLL_FRAC_BITS);
+  return rounded;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) static void
+pll_gap(pll_t *pll, uint32_t start, unsigned int missing) {
+  uint32_t interval = start - pll->gap_last;
+  uint32_t tol = pll->gap_interval / 32;
+
+  if ((pll->gap_interval > 0) && (interval + tol >= pll->gap_interval) &&
+      (interval <= pll->gap_interval + tol)) {
+    if (pll->gap_hits < PLL_GAP_HITS)
+      pll->gap_hits++;
+    pll->gap_interval = (pll->gap_interval + interval) / 2;
+    pll->gap_len = (missing > pll->gap_len) ? missing : pll->gap_len;
+  } else {
+    /* Nothing to compare against on the first gap */
+    pll->gap_interval = (pll->gap_last > 0) ? interval : 0;
+    pll->gap_len = missing;
+    pll->gap_hits = 0;
+  }
+  pll->gap_last = start;
+}
+
+unsigned int pll_rate(int32_t freq) {
+  /* Lamps flicker at twice the grid frequency of 50Hz or 60Hz, see
+   * FLYNC_CLOCK_FREQ_100HZ and FLYNC_CLOCK_FREQ_120HZ */
+  static const unsigned int rates[] = {100, 120};
+
+  for (unsigned int i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+    int32_t nominal =
+        (int32_t)((PLL_RTC_FREQUENCY << PLL_FRAC_BITS) / rates[i]);
+    int32_t dev = freq - nominal;
+    if ((dev < nominal >> PLL_FREQ_TOL_SHIFT) &&
+        (dev > -(nominal >> PLL_FREQ_TOL_SHIFT)))
+      return rates[i];
+  }
+  return 0;
+}
+
+void pll_init(pll_t *pll, unsigned int period, int32_t freq,
+              unsigned int decim_max) {
+  pll->period = period;
+  pll->frac = 0;
+  pll->phase_prev = 0;
+  pll->n_fll_gated = 0;
+  if (pll_rate(freq) > 0) {
+    /* Trust estimate from before brownout */
+    pll->freq = freq;
+    pll->n_fll = PLL_FLL_GAIN_MAX;
+  } else {
+    pll->freq = (int32_t)period << PLL_FRAC_BITS;
+    pll->n_fll = 0;
+  }
+
+  pll->decim = 1;
+  pll->decim_max = (decim_max > 0) ? decim_max : 1;
+  pll->n_locked = 0;
+  pll->n_rejected = 0;
+
+  pll->gap_last = 0;
+  pll->gap_interval = 0;
+  pll->gap_len = 0;
+  pll->gap_hits = 0;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+pll_update(pll_t *pll, unsigned int phase, unsigned int n_periods,
+           unsigned int n_edges, uint32_t now) {
+  trace_begin(TRACE_PLL_UPDATE);
+
+  /* The setpoint for the phase is half the period */
+  int32_t err = ((int32_t)phase << PLL_FRAC_BITS) - pll->freq / 2;
+
+  /*
+   * Reject spurious edges, unless they keep coming. Without edges, the phase
+   * wanders by up to half a tick per period, so the outlier threshold grows
+   * with the time since the last accepted edge.
+   */
+  int locked = (pll->decim > 1) || (pll->n_locked > 0);
+  int32_t outlier_thr =
+      (PLL_OUTLIER_THR << PLL_FRAC_BITS) + (int32_t)n_periods * (PLL_ONE / 2);
+  if ((err > pll->freq / 4) || (err < -pll->freq / 4) ||
+      (locked && ((err > outlier_thr) || (err < -outlier_thr)))) {
+    if (++pll->n_rejected < PLL_RELOCK_EDGES) {
+      trace_end(TRACE_PLL_UPDATE);
+      return 0;
+    }
+    pll->phase_prev = 0;
+  }
+  pll->n_rejected = 0;
+
+  /*
+   * Edges were missing since the previous update. We don't know how many of
+   * the counted edges came before the gap, so we assume it's half of them.
+   */
+  if (n_periods >= n_edges + PLL_GAP_MIN)
+    pll_gap(pll, now - n_periods + (n_edges + 1) / 2, n_periods - n_edges);
+
+  /*
+   * The period register was constant since the previous edge, so the drift
+   * of the phase is the difference between flicker period and register.
+   */
+  if ((pll->phase_prev > 0) && (n_periods > 0) &&
+      (n_periods <= PLL_FLL_MAX_SPAN)) {
+    int32_t drift = ((int32_t)phase - (int32_t)pll->phase_prev)
+                    << PLL_FRAC_BITS;
+    int32_t sample =
+        ((int32_t)pll->period << PLL_FRAC_BITS) + drift / (int32_t)n_periods;
+
+    /* Samples far off the estimate come from spurious edges, or the
+     * estimate is stale if they keep coming */
+    int32_t dev = sample - pll->freq;
+    int32_t tol = pll->freq >> PLL_FREQ_TOL_SHIFT;
+    if ((dev < tol) && (dev > -tol)) {
+      pll->n_fll_gated = 0;
+      if (pll->n_fll < PLL_FLL_GAIN_MAX)
+        pll->n_fll++;
+      pll->freq += dev / (int32_t)pll->n_fll;
+    } else if ((++pll->n_fll_gated >= PLL_FLL_REACQUIRE) &&
+               (pll_rate(sample) > 0)) {
+      pll->n_fll_gated = 0;
+      pll->n_fll = 1;
+      pll->freq = sample;
+    }
+  }
+  pll->phase_prev = phase;
+
+  /*
+   * Update less often while locked, fall back on every edge otherwise. The
+   * period is an integer number of ticks, so the phase wanders by up to half
+   * a tick per period between two updates.
+   */
+  int32_t lock_thr = (PLL_LOCK_THR << PLL_FRAC_BITS) +
+                     (int32_t)pll->decim * (PLL_ONE / 2);
+  if ((err <= lock_thr) && (err >= -lock_thr)) {
+    if ((++pll->n_locked >= PLL_LOCK_UPDATES) &&
+        (pll->decim < pll->decim_max)) {
+      pll->decim *= 2;
+      if (pll->decim > pll->decim_max)
+        pll->decim = pll->decim_max;
+      pll->n_locked = 0;
+    }
+  } else {
+    pll->decim = 1;
+    pll->n_locked = 0;
+  }
+
+  /* Spread phase correction over the periods until the next update */
+  pll->period = pll_round(
+      pll, pll->freq + err / (PLL_PHASE_GAIN * (int32_t)pll->decim));
+  trace_end(TRACE_PLL_UPDATE);
+  return pll->period;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) int
+pll_holdover(const pll_t *pll, uint32_t now) {
+  if (pll->gap_hits < PLL_GAP_HITS)
+    return 0;
+
+  /* Start of gaps is only known up to the decimation */
+  uint32_t margin = PLL_GAP_MARGIN + pll->decim_max / 2;
+  uint32_t pos = (now - pll->gap_last) % pll->gap_interval;
+  return (pos + margin >= pll->gap_interval) ||
+         (pos < pll->gap_len + margin);
+}
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+pll_freerun(pll_t *pll) {
+  pll->period = pll_round(pll, pll->freq);
+  /* Register changes, so the next phase drift is no frequency sample */
+  pll->phase_prev = 0;
+  return pll->period;
+}
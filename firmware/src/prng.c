@@ -4,49 +4,94 @@
 #include <math.h>
 
 #include "peripherals.h"
+#include "prng.h"
+#include "trace.h"
 
 static uint32_t prng_x;
+static uint32_t prng_y = 362436069;
+static uint32_t prng_z = 521288629;
+static uint32_t prng_w = 88675123;
 
 /* This symbol is defined in the object file generated from the binary LUT */
 extern volatile unsigned char _binary__build_opt_scale_bin_start;
 
 void prng_seed(uint32_t seed) { prng_x = NRF_FICR->DEVICEID[0]; }
 
+void prng_restore(const uint32_t *state) {
+  prng_x = state[0];
+  prng_y = state[1];
+  prng_z = state[2];
+  prng_w = state[3];
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void
+prng_save(uint32_t *state) {
+  state[0] = prng_x;
+  state[1] = prng_y;
+  state[2] = prng_z;
+  state[3] = prng_w;
+}
+
 __attribute__((long_call, section(".ramfunctions"))) uint32_t
 prng_urand(uint32_t min, uint32_t max) {
-  static uint32_t y = 362436069;
-  static uint32_t z = 521288629;
-  static uint32_t w = 88675123;
   uint32_t t;
   t = prng_x ^ (prng_x << 11);
-  prng_x = y;
-  y = z;
-  z = w;
-  w = w ^ (w >> 19) ^ (t ^ (t >> 8));
-  return w % (max - min) + min;
+  prng_x = prng_y;
+  prng_y = prng_z;
+  prng_z = prng_w;
+  prng_w = prng_w ^ (prng_w >> 19) ^ (t ^ (t >> 8));
+  return prng_w % (max - min) + min;
+}
+
+/* Splits a value into a LUT index and an 8-bit fraction towards next index */
+__attribute__((long_call, section(".ramfunctions"))) static inline unsigned int
+lut_index(unsigned int value, unsigned int first, unsigned int step,
+          unsigned int len, unsigned int *frac) {
+  if (value <= first) {
+    *frac = 0;
+    return 0;
+  }
+  unsigned int idx = (value - first) / step;
+  if (idx >= len - 1) {
+    *frac = 256;
+    return len - 2;
+  }
+  *frac = ((value - first) % step) * 256 / step;
+  return idx;
 }
 
 /* For some reason, this function fails when optimized */
 __attribute__((optimize("O0")))
 __attribute__((long_call, section(".ramfunctions"))) float
-lookup_scale(unsigned int t_chr) {
-  float *scale_tab = (float *)&_binary__build_opt_scale_bin_start;
-
-  if (t_chr < 10)
-    return scale_tab[0];
-  else if (t_chr > 2560)
-    return scale_tab[255];
-
-  volatile int idx_low = (t_chr / 10) - 1;
-  volatile float val_low = scale_tab[idx_low];
-  volatile float val_high = scale_tab[t_chr / 10];
-  float frac = (float)(t_chr % 10) / 10.0f;
-  return val_low + frac * (val_high - val_low);
+lookup_scale(unsigned int t_chr, unsigned int density) {
+  const uint16_t *scale_tab =
+      (const uint16_t *)&_binary__build_opt_scale_bin_start;
+
+  unsigned int t_frac, d_frac;
+  unsigned int t_idx =
+      lut_index(t_chr, LUT_TCHR_STEP, LUT_TCHR_STEP, LUT_TCHR_LEN, &t_frac);
+  unsigned int d_idx = lut_index(density,
+                                 LUT_DENSITY_MIN << LUT_DENSITY_FRAC_BITS,
+                                 LUT_DENSITY_STEP << LUT_DENSITY_FRAC_BITS,
+                                 LUT_DENSITY_LEN, &d_frac);
+
+  const uint16_t *row_low = &scale_tab[t_idx * LUT_DENSITY_LEN + d_idx];
+  const uint16_t *row_high = row_low + LUT_DENSITY_LEN;
+
+  /* Interpolate along charging time, keeping Q0.16 scale */
+  uint32_t val_low = (row_low[0] * (256 - t_frac) + row_high[0] * t_frac) >> 8;
+  uint32_t val_high = (row_low[1] * (256 - t_frac) + row_high[1] * t_frac) >> 8;
+
+  /* Interpolate along density */
+  uint32_t val = (val_low * (256 - d_frac) + val_high * d_frac) >> 8;
+  return (float)val / 65536.0f;
 }
 
 __attribute__((long_call, section(".ramfunctions"))) unsigned int
 geometric_itf_sample(float p) {
+  trace_begin(TRACE_ITF_SAMPLE);
   float y = (float)prng_urand(0, 4096) / 4096;
   unsigned int res = (unsigned int)(logf(1 - y) / logf(1 - p) - 1.0f);
+  trace_end(TRACE_ITF_SAMPLE);
   return res;
 }
\ No newline at end of file
@@ -6,6 +6,63 @@
 #include "flync.h"
 #include "radio.h"
 
+#define RTC_FREQUENCY 32768UL
+
+/*
+ * Coded PHY sends preamble, address, coding indicator and TERM1 with S=8,
+ * i.e. 80us + 4 * 64us + 16us + 24us, only payload, CRC and TERM2 use the
+ * coding of the profile.
+ */
+static const radio_profile_t profiles[RADIO_N_PROFILES] = {
+    [RADIO_PROFILE_1M] = {.mode = RADIO_MODE_MODE_Ble_1Mbit,
+                          .plen = RADIO_PCNF0_PLEN_8bit,
+                          .balen = 2,
+                          .crc_len = 1,
+                          .crc_poly = 0x107UL,
+                          .crc_init = 0xFFUL,
+                          .tifs_us = 50,
+                          .head_us = 8 + 3 * 8,
+                          .byte_us = 8},
+    [RADIO_PROFILE_2M] = {.mode = RADIO_MODE_MODE_Ble_2Mbit,
+                          .plen = RADIO_PCNF0_PLEN_8bit,
+                          .balen = 2,
+                          .crc_len = 1,
+                          .crc_poly = 0x107UL,
+                          .crc_init = 0xFFUL,
+                          .tifs_us = 50,
+                          .head_us = 4 + 3 * 4,
+                          .byte_us = 4},
+    [RADIO_PROFILE_CODED_S2] = {.mode = RADIO_MODE_MODE_Ble_LR500Kbit,
+                                .plen = RADIO_PCNF0_PLEN_LongRange,
+                                .cilen = 2,
+                                .termlen = 3,
+                                .balen = 3,
+                                .crc_len = 3,
+                                .crc_poly = 0x65BUL,
+                                .crc_init = 0x555555UL,
+                                .tifs_us = 150,
+                                .head_us = 80 + 4 * 64 + 16 + 24,
+                                .tail_us = 3 * 2,
+                                .byte_us = 16},
+    [RADIO_PROFILE_CODED_S8] = {.mode = RADIO_MODE_MODE_Ble_LR125Kbit,
+                                .plen = RADIO_PCNF0_PLEN_LongRange,
+                                .cilen = 2,
+                                .termlen = 3,
+                                .balen = 3,
+                                .crc_len = 3,
+                                .crc_poly = 0x65BUL,
+                                .crc_init = 0x555555UL,
+                                .tifs_us = 150,
+                                .head_us = 80 + 4 * 64 + 16 + 24,
+                                .tail_us = 3 * 8,
+                                .byte_us = 64},
+};
+
+static const radio_profile_t *profile = &profiles[RADIO_PROFILE];
+static unsigned int payload_len;
+static unsigned int airtime_us;
+static int txpower;
+
 static int radio_setup_gpio(unsigned int gpio_pin) {
   NRF_GPIOTE->CONFIG[1] = (GPIOTE_CONFIG_MODE_Task << 0) | (gpio_pin << 8) |
                           (GPIOTE_CONFIG_POLARITY_Toggle << 16) |
@@ -45,14 +102,68 @@ int radio_enable_event(volatile uint32_t *hw_event, uint32_t intenset_mask) {
   return 0;
 }
 
-int radio_init(unsigned int gpio_pin) {
-  /* 0dBm TX power */
-  NRF_RADIO->TXPOWER =
-      (RADIO_TXPOWER_TXPOWER_Neg8dBm << RADIO_TXPOWER_TXPOWER_Pos);
-  /* 2450 MHz frequency */
+int radio_set_profile(enum RadioProfile id) {
+  if (id >= RADIO_N_PROFILES)
+    return -1;
+  profile = &profiles[id];
+
+  NRF_RADIO->MODE = (profile->mode << RADIO_MODE_MODE_Pos);
+
+  /* No S0, LEN and S1 fields */
+  NRF_RADIO->PCNF0 = (0 << RADIO_PCNF0_S1LEN_Pos) |
+                     (0 << RADIO_PCNF0_S0LEN_Pos) |
+                     (0 << RADIO_PCNF0_LFLEN_Pos) |
+                     (profile->plen << RADIO_PCNF0_PLEN_Pos) |
+                     (profile->cilen << RADIO_PCNF0_CILEN_Pos) |
+                     (profile->termlen << RADIO_PCNF0_TERMLEN_Pos);
+
+  /* No whitening, little endian, static payload */
+  NRF_RADIO->PCNF1 = (RADIO_PCNF1_WHITEEN_Disabled << RADIO_PCNF1_WHITEEN_Pos) |
+                     (RADIO_PCNF1_ENDIAN_Little << RADIO_PCNF1_ENDIAN_Pos) |
+                     (profile->balen << RADIO_PCNF1_BALEN_Pos) |
+                     (payload_len << RADIO_PCNF1_STATLEN_Pos) |
+                     (payload_len << RADIO_PCNF1_MAXLEN_Pos);
+
+  NRF_RADIO->CRCCNF = (profile->crc_len << RADIO_CRCCNF_LEN_Pos);
+  NRF_RADIO->CRCINIT = profile->crc_init;
+  NRF_RADIO->CRCPOLY = profile->crc_poly;
+
+  /* Slightly longer than turnaround time (~40us) with fast ramp-up */
+  NRF_RADIO->TIFS = profile->tifs_us;
+
+  airtime_us = profile->head_us + (payload_len + profile->crc_len) *
+                                      profile->byte_us + profile->tail_us;
+  return 0;
+}
+
+const radio_profile_t *radio_profile(void) { return profile; }
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+radio_airtime_us(void) {
+  return airtime_us;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+radio_airtime_tcks(void) {
+  return (airtime_us * RTC_FREQUENCY + 999999UL) / 1000000UL;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void
+radio_set_txpower(int dbm) {
+  /* Register holds the power in dBm as two's complement */
+  NRF_RADIO->TXPOWER = ((uint8_t)dbm << RADIO_TXPOWER_TXPOWER_Pos);
+  txpower = dbm;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) int radio_txpower(void) {
+  return txpower;
+}
+
+int radio_init(unsigned int gpio_pin, unsigned int len) {
+  /* -8dBm TX power until power control selects a level */
+  radio_set_txpower(-8);
+  /* 2450 MHz frequency, discovery tunes to the channel of its hop slot */
   NRF_RADIO->FREQUENCY = 50UL;
-  /* BLE 1MBit */
-  NRF_RADIO->MODE = (RADIO_MODE_MODE_Ble_2Mbit << RADIO_MODE_MODE_Pos);
   /* Fast radio rampup */
   NRF_RADIO->MODECNF0 = (RADIO_MODECNF0_RU_Fast << RADIO_MODECNF0_RU_Pos);
 
@@ -67,25 +178,9 @@ int radio_init(unsigned int gpio_pin) {
   NRF_RADIO->RXADDRESSES =
       (1UL << LA_ACK_YES) | (1UL << LA_ACK_NO) | (1UL << LA_BCN);
 
-  /* Make interframe spacing slightly longer than turnaround time (~40us) */
-  NRF_RADIO->TIFS = 50;
-
-  /* No S0, LEN and S1 fields */
-  NRF_RADIO->PCNF0 = (0 << RADIO_PCNF0_S1LEN_Pos) |
-                     (0 << RADIO_PCNF0_S0LEN_Pos) |
-                     (0 << RADIO_PCNF0_LFLEN_Pos);
-
-  /* No whitening, little endian, 2B base address, 4B payload */
-  NRF_RADIO->PCNF1 = (RADIO_PCNF1_WHITEEN_Disabled << RADIO_PCNF1_WHITEEN_Pos) |
-                     (RADIO_PCNF1_ENDIAN_Little << RADIO_PCNF1_ENDIAN_Pos) |
-                     (2 << RADIO_PCNF1_BALEN_Pos) |
-                     (6 << RADIO_PCNF1_STATLEN_Pos) |
-                     (6 << RADIO_PCNF1_MAXLEN_Pos);
-
-  /* One byte CRC */
-  NRF_RADIO->CRCCNF = (RADIO_CRCCNF_LEN_One << RADIO_CRCCNF_LEN_Pos);
-  NRF_RADIO->CRCINIT = 0xFFUL;
-  NRF_RADIO->CRCPOLY = 0x107UL;
+  /* PHY, packet format and interframe spacing */
+  payload_len = len;
+  radio_set_profile(RADIO_PROFILE);
 
   /* Set default shorts */
   NRF_RADIO->SHORTS = NRF_RADIO_SHORT_READY_START_MASK;
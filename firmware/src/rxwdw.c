@@ -0,0 +1,19 @@
+#include <stdint.h>
+
+#include "charge.h"
+#include "rxwdw.h"
+
+static const uint8_t margins[] = RXWDW_LUT;
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+rxwdw_select(unsigned int v_adc, unsigned int min_tcks) {
+  /* Highest entry whose voltage has been reached */
+  unsigned int idx = RXWDW_LUT_LEN;
+  while ((idx > 0) &&
+         (v_adc < V2ADC(RXWDW_LUT_V_MIN + (idx - 1) * RXWDW_LUT_V_STEP)))
+    idx--;
+
+  if ((idx == 0) || (margins[idx - 1] < min_tcks))
+    return min_tcks;
+  return margins[idx - 1];
+}
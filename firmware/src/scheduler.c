@@ -0,0 +1,69 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nrf52840.h"
+
+#include "peripherals.h"
+#include "pt.h"
+#include "scheduler.h"
+
+typedef struct {
+  struct pt pt;
+  sched_fn_t fn;
+  /* Events on which the thread is resumed */
+  uint32_t events;
+} sched_thread_t;
+
+static sched_thread_t threads[SCHED_MAX_THREADS];
+static unsigned int n_threads = 0;
+
+/* Thread that is currently resumed by sched_run */
+static sched_thread_t *current = NULL;
+
+/* Events notified since the last pass, all threads run on the first pass */
+static volatile uint32_t pending = SCHED_EVT_ANY;
+
+int sched_add(sched_fn_t fn) {
+  if (n_threads >= SCHED_MAX_THREADS)
+    return -1;
+
+  threads[n_threads].pt = (const struct pt)pt_init();
+  threads[n_threads].fn = fn;
+  threads[n_threads].events = SCHED_EVT_ANY;
+  n_threads++;
+  return 0;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void
+sched_block(uint32_t events) {
+  if (current != NULL)
+    current->events = events;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void
+sched_notify(uint32_t events) {
+  /* Interrupts of higher priority may notify concurrently */
+  __atomic_fetch_or(&pending, events, __ATOMIC_RELEASE);
+  /* Make the next WFE return, in case sched_run is about to sleep */
+  __SEV();
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void sched_run(void) {
+  for (;;) {
+    uint32_t events = __atomic_exchange_n(&pending, 0, __ATOMIC_ACQUIRE);
+
+    for (unsigned int i = 0; i < n_threads; i++) {
+      sched_thread_t *t = &threads[i];
+      if (((t->events & events) == 0) ||
+          (pt_status(&t->pt) == PT_STATUS_FINISHED))
+        continue;
+      current = t;
+      t->fn(&t->pt);
+    }
+    current = NULL;
+
+    /* Events notified while threads were running are handled right away */
+    if (pending == 0)
+      enter_low_power();
+  }
+}
@@ -1,7 +1,10 @@
 #include "nrf52840.h"
 #include "nrf52840_bitfields.h"
 
-#define STACK_TOP (void *)0x20002000
+#include "warmboot.h"
+
+/* Top of the powered RAM blocks RAM[0] and RAM[1], must match linker.ld */
+#define STACK_TOP (void *)0x20004000
 
 extern unsigned long _stext;
 extern unsigned long _sbss;
@@ -164,12 +167,18 @@ void Default_Handler(void) {
   };
 }
 
-void lf_rtc_start(void) {
+void lf_rtc_start(bool settle) {
 
   /* Start LFCLK in LFRC low power mode */
   NRF_CLOCK->LFRCMODE |= 1;
   NRF_CLOCK->TASKS_LFCLKSTART = 1;
 
+  if (!settle) {
+    NRF_RTC0->TASKS_CLEAR = 1;
+    NRF_RTC0->TASKS_START = 1;
+    return;
+  }
+
   /* Use RTC to wait for 1s until everything has settled */
   NRF_RTC0->CC[1] = 32768 / 2;
   NRF_RTC0->EVTENSET = RTC_EVTENSET_COMPARE1_Msk;
@@ -202,11 +211,15 @@ void c_startup(void) {
   NRF_P0->PIN_CNF[24] = 0x03;
   NRF_P0->OUTSET = (1 << 24);
 
-  /* Start the RTC while waiting for cap voltage to recover from reset */
-  lf_rtc_start();
+  /* Check for state retained through brownout, before RAM is initialized */
+  enum WarmbootSource boot = warmboot_restore();
+
+  /* Start the RTC while waiting for cap voltage to recover from reset. After a
+   * brownout with retained RAM, the voltage is known to be sufficient. */
+  lf_rtc_start(boot != WARMBOOT_RAM);
 
-  /* Poweroff unused RAM sections */
-  for (unsigned int i = 1; i < 8; i++)
+  /* Poweroff unused RAM sections, RAM[0] and RAM[1] hold data and stack */
+  for (unsigned int i = 2; i < 8; i++)
     NRF_POWER->RAM[i].POWERCLR = 0xFFFFFFFF;
 
   src = &_etext;
@@ -0,0 +1,48 @@
+#include "subslot.h"
+
+#define RTC_FREQUENCY 32768UL
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+subslot_spacing(unsigned int airtime_us, unsigned int tifs_us) {
+  unsigned int span_us = 2 * airtime_us + tifs_us;
+  return (span_us * RTC_FREQUENCY + 999999UL) / 1000000UL +
+         DISCO_SUBSLOT_GUARD_TCKS;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+subslot_count(unsigned int period_tcks, unsigned int start_tcks,
+              unsigned int spacing_tcks) {
+  unsigned int first = start_tcks + DISCO_TX_DELAY_TCKS;
+  if (first >= period_tcks)
+    return 1;
+
+  unsigned int n = (period_tcks - first) / spacing_tcks;
+  if (n < 1)
+    return 1;
+  return (n < DISCO_SUBSLOTS) ? n : DISCO_SUBSLOTS;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+subslot_beacon(unsigned int start_tcks, unsigned int subslot,
+               unsigned int spacing_tcks) {
+  return start_tcks + DISCO_TX_DELAY_TCKS + subslot * spacing_tcks;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+subslot_reachable(unsigned int now_tcks, unsigned int lead_tcks,
+                  unsigned int start_tcks, unsigned int subslot,
+                  unsigned int n_subslots, unsigned int spacing_tcks) {
+  /* One more tick, as the compare value must lie ahead of the counter */
+  while ((subslot < n_subslots) &&
+         (subslot_beacon(start_tcks, subslot, spacing_tcks) <=
+          now_tcks + lead_tcks + 1))
+    subslot++;
+  return subslot;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+subslot_window(unsigned int n_subslots, unsigned int subslot,
+               unsigned int spacing_tcks, unsigned int rx_wdw_tcks) {
+  unsigned int wdw_tcks = (n_subslots - 1 - subslot) * spacing_tcks;
+  return (wdw_tcks > rx_wdw_tcks) ? wdw_tcks : rx_wdw_tcks;
+}
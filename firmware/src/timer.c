@@ -4,127 +4,212 @@
 #include "pt.h"
 #include <stdbool.h>
 
+#include "flync.h"
 #include "printf.h"
+#include "scheduler.h"
 #include "timer.h"
+#include "timerq.h"
 
-#define TIMER_INACTIVE 0
+/* RTC0 CC[0] triggers beacon transmission and CC[1] holds the flync period */
+#define TIMER_RTC_CC 2
+/* Compare values closer to the counter may not generate an event */
+#define TIMER_RTC_MIN_TICKS 2
 
+#if !FLYNC_HW_CAPTURE
 /* This holds the current system time in flync clock ticks */
 static unsigned int timer_counter = 1;
+#endif
 
-/* Event for RTC timer */
-static volatile pt_event_t rtc_event = pt_event_init();
-/* Event for flync timer */
-static volatile pt_event_t timer_event = pt_event_init();
+/* Pending software timers */
+static timerq_t timers;
 
-/* Stores value of flync timer */
-static unsigned int timer_timeout = 0;
+#if FLYNC_HW_CAPTURE
+int timer_init(void) {
+  timerq_init(&timers);
+
+  /* TIMER3 counts flync periods, system time is offset by one */
+  NRF_TIMER3->MODE = TIMER_MODE_MODE_LowPowerCounter;
+  NRF_TIMER3->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+  NRF_TIMER3->TASKS_CLEAR = 1;
+  NRF_TIMER3->TASKS_START = 1;
+
+  NRF_PPI->CH[12].EEP = (uint32_t)&NRF_RTC0->EVENTS_COMPARE[1];
+  NRF_PPI->CH[12].TEP = (uint32_t)&NRF_TIMER3->TASKS_COUNT;
+  NRF_PPI->CHENSET = PPI_CHENSET_CH12_Msk;
+
+  NVIC_ClearPendingIRQ(TIMER3_IRQn);
+  NVIC_EnableIRQ(TIMER3_IRQn);
+  return 0;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+timer_now(void) {
+  NRF_TIMER3->TASKS_CAPTURE[0] = 1;
+  return NRF_TIMER3->CC[0] + 1;
+}
+#else
+int timer_init(void) {
+  timerq_init(&timers);
+  return 0;
+}
 
 __attribute__((long_call, section(".ramfunctions"))) unsigned int
 timer_now(void) {
   return timer_counter;
 }
+#endif
+
+/*
+ * Fires expired timers and arms the hardware for the earliest pending one.
+ * Must be called with interrupts disabled or from a timer interrupt.
+ */
+__attribute__((long_call, section(".ramfunctions"))) static void
+timer_dispatch(void) {
+  timerq_entry_t *e;
+  uint32_t now;
+
+  do {
+    now = timer_now();
+    /* Timers that are too close to arm fire a little early instead */
+    while ((e = timerq_expire(&timers, now,
+                              NRF_RTC0->COUNTER + TIMER_RTC_MIN_TICKS))) {
+      pt_event_set(&e->evt);
+      sched_notify(SCHED_EVT_TIMER);
+    }
+
+    NRF_RTC0->INTENCLR = RTC_INTENCLR_COMPARE2_Msk;
+    NRF_RTC0->EVENTS_COMPARE[TIMER_RTC_CC] = 0;
+#if FLYNC_HW_CAPTURE
+    NRF_TIMER3->INTENCLR = TIMER_INTENCLR_COMPARE1_Msk;
+    NRF_TIMER3->EVENTS_COMPARE[1] = 0;
+#endif
+
+    e = timerq_peek(&timers);
+    if (e == NULL)
+      return;
+
+    if (e->tick == now) {
+      NRF_RTC0->CC[TIMER_RTC_CC] = e->rtc;
+      NRF_RTC0->INTENSET = RTC_INTENSET_COMPARE2_Msk;
+    }
+#if FLYNC_HW_CAPTURE
+    /*
+     * Counter lags system time by one, so compare fires at the start of the
+     * deadline's period. Within that period, it also catches the next edge in
+     * case the PLL shortens the period below the RTC compare value.
+     */
+    NRF_TIMER3->CC[1] = (e->tick == now) ? now : e->tick - 1;
+    NRF_TIMER3->INTENSET = TIMER_INTENSET_COMPARE1_Msk;
+#endif
+
+    /* Flync period may have ended while arming */
+  } while (timer_now() != now);
+}
 
-__attribute__((long_call, section(".ramfunctions"))) volatile pt_event_t *
-timer_rtc_wait(unsigned int wait_ticks) {
-  return timer_rtc_set(NRF_RTC0->COUNTER + wait_ticks);
+/*
+ * Queues the timer and rearms the hardware. Must be called with interrupts
+ * disabled, so that the caller's view of counter and system time stays valid.
+ */
+__attribute__((long_call, section(".ramfunctions"))) static volatile pt_event_t
+    *timer_arm(timer_handle_t *timer, uint32_t tick, uint32_t rtc) {
+  timer->tick = tick;
+  timer->rtc = rtc;
+  timerq_normalize(&timer->tick, &timer->rtc, NRF_RTC0->CC[1]);
+  int rc = timerq_insert(&timers, timer);
+  timer_dispatch();
+
+  return (rc == 0) ? &timer->evt : NULL;
 }
 
 __attribute__((long_call, section(".ramfunctions"))) volatile pt_event_t *
-timer_rtc_set(unsigned int rtc_ticks) {
-
-  /* Make sure that the timer is not already armed */
-  if (NRF_RTC0->INTENSET & RTC_INTENSET_COMPARE1_Msk)
-    timer_rtc_cancel();
-
-  NRF_RTC0->CC[0] = rtc_ticks;
-  NRF_RTC0->EVENTS_COMPARE[0] = 0;
-  NRF_RTC0->EVTENSET = RTC_EVTENSET_COMPARE0_Msk;
-  NRF_RTC0->INTENSET = RTC_INTENSET_COMPARE0_Msk;
-  pt_event_clear(&rtc_event);
-  return &rtc_event;
+timer_rtc_wait(timer_handle_t *timer, unsigned int wait_ticks) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  /* Counter and system time must belong to the same flync period */
+  volatile pt_event_t *evt =
+      timer_arm(timer, timer_now(), NRF_RTC0->COUNTER + wait_ticks);
+
+  __set_PRIMASK(primask);
+  return evt;
 }
 
-__attribute__((long_call, section(".ramfunctions"))) int
-timer_rtc_cancel(void) {
-  if ((NRF_RTC0->EVTEN & RTC_EVTEN_COMPARE0_Msk) == 0)
-    return -1;
+__attribute__((long_call, section(".ramfunctions"))) volatile pt_event_t *
+timer_rtc_set(timer_handle_t *timer, unsigned int rtc_ticks) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
 
-  NRF_RTC0->EVTENCLR = RTC_EVTENCLR_COMPARE0_Msk;
-  NRF_RTC0->INTENCLR = RTC_INTENCLR_COMPARE0_Msk;
-  NRF_RTC0->EVENTS_COMPARE[0] = 0;
+  volatile pt_event_t *evt = timer_arm(timer, timer_now(), rtc_ticks);
 
-  return 0;
+  __set_PRIMASK(primask);
+  return evt;
 }
 
 __attribute__((long_call, section(".ramfunctions"))) volatile pt_event_t *
-timer_flync_wait(unsigned int wait_time) {
-  return timer_flync_set(timer_counter + 1 + wait_time);
+timer_flync_wait(timer_handle_t *timer, unsigned int wait_time) {
+  return timer_flync_set(timer, timer_now() + 1 + wait_time);
 }
 
 __attribute__((long_call, section(".ramfunctions"))) volatile pt_event_t *
-timer_flync_set(unsigned int time) {
-  /* Make sure timer is not already armed */
-  if (timer_timeout != TIMER_INACTIVE)
-    timer_flync_cancel();
+timer_flync_set(timer_handle_t *timer, unsigned int time) {
+  volatile pt_event_t *evt = NULL;
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
 
   /* Cannot set timer in the past */
-  if (time < (timer_counter + 1))
-    return NULL;
-  /* Timer requested at very next clock edge */
-  else if (time == (timer_counter + 1)) {
-    /* Enable interrupt now */
-    NRF_RTC0->EVENTS_COMPARE[1] = 0;
-    NVIC_ClearPendingIRQ(RTC0_IRQn);
-    NRF_RTC0->INTENSET = RTC_INTENSET_COMPARE1_Msk;
-  }
-  timer_timeout = time;
-  pt_event_clear(&timer_event);
-  return &timer_event;
+  if ((int32_t)(time - (timer_now() + 1)) >= 0)
+    evt = timer_arm(timer, time, 0);
+
+  __set_PRIMASK(primask);
+  return evt;
 }
 
 __attribute__((long_call, section(".ramfunctions"))) int
-timer_flync_cancel(void) {
-  if (timer_timeout == TIMER_INACTIVE)
-    return -1;
+timer_cancel(timer_handle_t *timer) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
 
-  NRF_RTC0->EVENTS_COMPARE[1] = 0;
-  NVIC_ClearPendingIRQ(RTC0_IRQn);
-  NRF_RTC0->INTENCLR = RTC_INTENCLR_COMPARE1_Msk;
+  int rc = timerq_remove(&timers, timer);
+  /* Hardware may be armed for the removed timer */
+  if (rc == 0)
+    timer_dispatch();
 
-  timer_timeout = TIMER_INACTIVE;
-  return 0;
+  __set_PRIMASK(primask);
+  return rc;
 }
 
+#if FLYNC_HW_CAPTURE
+__attribute__((long_call, section(".ramfunctions"))) void
+TIMER3_IRQHandler(void) {
+  /* Interrupt at start of the earliest deadline's flync period */
+  if (NRF_TIMER3->EVENTS_COMPARE[1] == 1) {
+    NRF_TIMER3->EVENTS_COMPARE[1] = 0;
+    timer_dispatch();
+  }
+}
+#else
 __attribute__((long_call, section(".ramfunctions"))) void _timer_tick(void) {
   /* Increment system time */
   timer_counter++;
-  /* Check if timer has expired */
-  if (timer_timeout == (timer_counter + 1)) {
-    NRF_RTC0->EVENTS_COMPARE[1] = 0;
-    NVIC_ClearPendingIRQ(RTC0_IRQn);
-    NRF_RTC0->INTENSET = RTC_INTENSET_COMPARE1_Msk;
-  }
+  /* Fire flync timers and arm RTC timers of the new period */
+  timer_dispatch();
 }
+#endif
 
 __attribute__((long_call, section(".ramfunctions"))) void
 RTC0_IRQHandler(void) {
-  /* Interrupt for flync timer */
+#if FLYNC_HW_CAPTURE
+  /* Tick interrupt is only enabled by flync during MPPT gaps */
   if ((NRF_RTC0->EVENTS_COMPARE[1] == 1) &&
       (NRF_RTC0->INTENSET & RTC_INTENSET_COMPARE1_Msk)) {
     NRF_RTC0->EVENTS_COMPARE[1] = 0;
-    NRF_RTC0->INTENCLR = RTC_INTENCLR_COMPARE1_Msk;
-
-    pt_event_set(&timer_event);
-    timer_timeout = TIMER_INACTIVE;
+    _flync_tick();
   }
-  /* Interrupt for RTC timer */
-  if ((NRF_RTC0->EVENTS_COMPARE[0] == 1) &&
-      (NRF_RTC0->INTENSET & RTC_INTENSET_COMPARE0_Msk)) {
-    NRF_RTC0->EVENTS_COMPARE[0] = 0;
-    NRF_RTC0->INTENCLR = RTC_INTENCLR_COMPARE0_Msk;
-    NRF_RTC0->EVTENCLR = RTC_EVTENCLR_COMPARE0_Msk;
-
-    pt_event_set(&rtc_event);
+#endif
+  /* Interrupt for earliest RTC timer */
+  if ((NRF_RTC0->EVENTS_COMPARE[TIMER_RTC_CC] == 1) &&
+      (NRF_RTC0->INTENSET & RTC_INTENSET_COMPARE2_Msk)) {
+    NRF_RTC0->EVENTS_COMPARE[TIMER_RTC_CC] = 0;
+    timer_dispatch();
   }
 }
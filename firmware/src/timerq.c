@@ -0,0 +1,107 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "timerq.h"
+
+__attribute__((long_call, section(".ramfunctions"))) int
+timerq_before(uint32_t a_tick, uint32_t a_rtc, uint32_t b_tick,
+              uint32_t b_rtc) {
+  int32_t diff = (int32_t)(a_tick - b_tick);
+  return (diff < 0) || ((diff == 0) && (a_rtc < b_rtc));
+}
+
+__attribute__((long_call, section(".ramfunctions"))) static int
+timerq_less(const timerq_t *q, unsigned int i, unsigned int j) {
+  return timerq_before(q->heap[i]->tick, q->heap[i]->rtc, q->heap[j]->tick,
+                       q->heap[j]->rtc);
+}
+
+__attribute__((long_call, section(".ramfunctions"))) static void
+timerq_swap(timerq_t *q, unsigned int i, unsigned int j) {
+  timerq_entry_t *tmp = q->heap[i];
+  q->heap[i] = q->heap[j];
+  q->heap[j] = tmp;
+  q->heap[i]->idx = i;
+  q->heap[j]->idx = j;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) static void
+timerq_sift_up(timerq_t *q, unsigned int i) {
+  while ((i > 0) && timerq_less(q, i, (i - 1) / 2)) {
+    timerq_swap(q, i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+__attribute__((long_call, section(".ramfunctions"))) static void
+timerq_sift_down(timerq_t *q, unsigned int i) {
+  for (;;) {
+    unsigned int min = i;
+    unsigned int l = 2 * i + 1;
+    unsigned int r = 2 * i + 2;
+    if ((l < q->n) && timerq_less(q, l, min))
+      min = l;
+    if ((r < q->n) && timerq_less(q, r, min))
+      min = r;
+    if (min == i)
+      return;
+    timerq_swap(q, i, min);
+    i = min;
+  }
+}
+
+void timerq_init(timerq_t *q) { q->n = 0; }
+
+__attribute__((long_call, section(".ramfunctions"))) void
+timerq_normalize(uint32_t *tick, uint32_t *rtc, unsigned int period) {
+  /* The RTC is cleared once it reaches the period */
+  *tick += *rtc / period;
+  *rtc %= period;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) int
+timerq_remove(timerq_t *q, timerq_entry_t *e) {
+  unsigned int i = e->idx;
+  if ((i >= q->n) || (q->heap[i] != e))
+    return -1;
+
+  /* Fill the gap with the last timer and restore heap order around it */
+  q->n--;
+  if (i < q->n) {
+    timerq_entry_t *last = q->heap[q->n];
+    q->heap[i] = last;
+    last->idx = i;
+    timerq_sift_up(q, i);
+    timerq_sift_down(q, last->idx);
+  }
+  e->idx = TIMERQ_IDLE;
+  return 0;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) int
+timerq_insert(timerq_t *q, timerq_entry_t *e) {
+  timerq_remove(q, e);
+  if (q->n >= TIMERQ_LEN)
+    return -1;
+
+  pt_event_clear(&e->evt);
+  e->idx = q->n;
+  q->heap[q->n++] = e;
+  timerq_sift_up(q, e->idx);
+  return 0;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) timerq_entry_t *
+timerq_peek(const timerq_t *q) {
+  return (q->n > 0) ? q->heap[0] : NULL;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) timerq_entry_t *
+timerq_expire(timerq_t *q, uint32_t tick, uint32_t rtc) {
+  timerq_entry_t *e = timerq_peek(q);
+  if ((e == NULL) || timerq_before(tick, rtc, e->tick, e->rtc))
+    return NULL;
+
+  timerq_remove(q, e);
+  return e;
+}
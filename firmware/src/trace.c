@@ -0,0 +1,59 @@
+#include <stdint.h>
+
+#ifndef TRACE_HOST
+#include "nrf52840.h"
+#endif
+
+#include "trace.h"
+#include "warmboot.h"
+
+#define TRACE_BUF_MASK (TRACE_BUF_LEN - 1)
+
+_Static_assert((TRACE_BUF_LEN & TRACE_BUF_MASK) == 0,
+               "trace ring length must be a power of two");
+
+#if TRACE_ENABLED
+#ifdef TRACE_HOST
+trace_buf_t trace_buf;
+
+static uint32_t host_cycles;
+static uint32_t host_rtc;
+
+void trace_host_clock(uint32_t cycles, uint32_t rtc) {
+  host_cycles = cycles;
+  host_rtc = rtc;
+}
+
+#define TRACE_CYCLES() host_cycles
+#define TRACE_RTC() host_rtc
+#else
+trace_buf_t trace_buf __attribute__((section(".noinit")));
+
+#define TRACE_CYCLES() DWT->CYCCNT
+#define TRACE_RTC() NRF_RTC0->COUNTER
+#endif
+
+__attribute__((long_call, section(".ramfunctions"))) void
+_trace_point(uint8_t id) {
+  /* Claim a slot first, so that interrupting trace points don't overwrite
+   * the record, and sample the clocks as late as possible */
+  uint32_t w = __atomic_fetch_add(&trace_buf.w, 1, __ATOMIC_RELAXED);
+  trace_rec_t *rec = &trace_buf.rec[w & TRACE_BUF_MASK];
+  rec->id_rtc = ((uint32_t)id << 24) | (TRACE_RTC() & 0xFFFFFF);
+  rec->cycles = TRACE_CYCLES();
+}
+
+void trace_init(void) {
+#ifndef TRACE_HOST
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+  retained_init(&trace_buf, sizeof(trace_buf), TRACE_MAGIC);
+  _trace_point(TRACE_BOOT);
+}
+
+void trace_period(unsigned int rtc_ticks) { trace_buf.rtc_period = rtc_ticks; }
+
+const trace_buf_t *trace_get(void) { return &trace_buf; }
+#endif
@@ -0,0 +1,82 @@
+#include <stdint.h>
+
+#include "neighbor.h"
+#include "txpwr.h"
+#include "warmboot.h"
+
+#define TXPWR_MAGIC 0x7C9B7C9BUL
+
+static const int8_t levels[] = TXPWR_LEVELS;
+#define TXPWR_N_LEVELS (sizeof(levels) / sizeof(levels[0]))
+
+static txpwr_state_t state __attribute__((section(".noinit")));
+
+/* Lowest level of at least the given power, the highest one otherwise */
+static unsigned int txpwr_level(int dbm) {
+  for (unsigned int i = 0; i < TXPWR_N_LEVELS; i++) {
+    if (levels[i] >= dbm)
+      return i;
+  }
+  return TXPWR_N_LEVELS - 1;
+}
+
+int txpwr_init(void) {
+  if (state.level >= TXPWR_N_LEVELS)
+    state.magic = 0;
+  if (!retained_init(&state, sizeof(state), TXPWR_MAGIC))
+    return 0;
+
+  state.level = txpwr_level(TXPWR_DEFAULT);
+  return 1;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) void
+txpwr_update(nbr_entry_t *entry, uint8_t rssi, int8_t tx_power) {
+  int32_t sample = tx_power + (int32_t)rssi;
+  if (sample < 1)
+    sample = 1;
+  sample <<= NBR_RSSI_FRAC_BITS;
+
+  if (entry->pathloss == 0)
+    entry->pathloss = sample;
+  else
+    entry->pathloss += (sample - (int32_t)entry->pathloss) >> TXPWR_SHIFT;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) int
+txpwr_adapt(unsigned int n_heard) {
+  /* Weakest link among recently heard neighbors */
+  uint32_t pathloss = 0;
+  unsigned int idx = 0;
+  nbr_entry_t *entry;
+  while ((entry = nbr_next(&idx)) != NULL) {
+    if ((nbr_now() - entry->last_seen <= TXPWR_HORIZON) &&
+        (entry->pathloss > pathloss))
+      pathloss = entry->pathloss;
+  }
+
+  /* Nobody to reach, search with the default level */
+  unsigned int base = txpwr_level(TXPWR_DEFAULT);
+  if (pathloss > 0)
+    base = txpwr_level(TXPWR_TARGET_RSSI +
+                       (int)((pathloss + (1 << NBR_RSSI_FRAC_BITS) - 1) >>
+                             NBR_RSSI_FRAC_BITS));
+
+  if (n_heard > 0) {
+    state.stalled = 0;
+    if (state.boost > 0)
+      state.boost--;
+  } else if (++state.stalled >= TXPWR_STALL_CYCLES) {
+    state.stalled = 0;
+    if (base + state.boost + 1 < TXPWR_N_LEVELS)
+      state.boost++;
+  }
+
+  unsigned int level = base + state.boost;
+  state.level = (level < TXPWR_N_LEVELS) ? level : TXPWR_N_LEVELS - 1;
+  return levels[state.level];
+}
+
+__attribute__((long_call, section(".ramfunctions"))) int txpwr_get(void) {
+  return levels[state.level];
+}
@@ -0,0 +1,51 @@
+#include <stdint.h>
+
+#include "vthr.h"
+#include "warmboot.h"
+
+#define VTHR_MAGIC 0x7E0A7E0AUL
+
+static vthr_state_t state __attribute__((section(".noinit")));
+
+int vthr_init(unsigned int v_default, unsigned int v_min, unsigned int v_max) {
+  if ((state.v_min != v_min) || (state.v_max != v_max) ||
+      (state.v_on < v_min) || (state.v_on > v_max))
+    state.magic = 0;
+  if (!retained_init(&state, sizeof(state), VTHR_MAGIC))
+    return 0;
+
+  state.v_on = v_default;
+  state.v_min = v_min;
+  state.v_max = v_max;
+  return 1;
+}
+
+unsigned int vthr_backoff(uint32_t brownouts) {
+  unsigned int v_on = state.v_on;
+
+  if (brownouts > state.brownouts)
+    v_on += VTHR_BACKOFF;
+  /* Counters were reset after a cold boot */
+  state.brownouts = brownouts;
+
+  state.v_on = (v_on < state.v_max) ? v_on : state.v_max;
+  return state.v_on;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+vthr_adapt(unsigned int v_disco) {
+  unsigned int v_on = state.v_on;
+
+  if (v_disco < state.v_min)
+    v_on += state.v_min - v_disco;
+  else
+    v_on = (v_on > state.v_min + VTHR_STEP) ? v_on - VTHR_STEP : state.v_min;
+
+  state.v_on = (v_on < state.v_max) ? v_on : state.v_max;
+  return state.v_on;
+}
+
+__attribute__((long_call, section(".ramfunctions"))) unsigned int
+vthr_get(void) {
+  return state.v_on;
+}
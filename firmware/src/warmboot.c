@@ -0,0 +1,128 @@
+#include "nrf52840.h"
+#include "nrf52840_bitfields.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "warmboot.h"
+
+#define WARMBOOT_MAGIC 0x5741524DUL
+
+#define WARMBOOT_NVM_RECORDS (WARMBOOT_NVM_SIZE / sizeof(warmboot_state_t))
+
+static warmboot_state_t state __attribute__((section(".noinit")));
+static enum WarmbootSource source __attribute__((section(".noinit")));
+/* Cycles sealed since the last NVM record was written */
+static unsigned int nvm_age __attribute__((section(".noinit")));
+
+/* Runs from flash, because RAM functions are not yet loaded at startup */
+static uint32_t warmboot_crc(const warmboot_state_t *st) {
+  const uint8_t *data = (const uint8_t *)st;
+  uint32_t crc = 0xFFFFFFFFUL;
+  for (size_t i = 0; i < offsetof(warmboot_state_t, crc); i++) {
+    crc ^= data[i];
+    for (unsigned int j = 0; j < 8; j++)
+      crc = (crc >> 1) ^ (0xEDB88320UL & -(crc & 1));
+  }
+  return ~crc;
+}
+
+static bool warmboot_check(const warmboot_state_t *st) {
+  return (st->magic == WARMBOOT_MAGIC) && (st->crc == warmboot_crc(st));
+}
+
+/* Returns index of first unused record in NVM page */
+static unsigned int nvm_free_idx(void) {
+  const warmboot_state_t *records = (const warmboot_state_t *)WARMBOOT_NVM_ADDR;
+  unsigned int i = 0;
+  while ((i < WARMBOOT_NVM_RECORDS) && (records[i].magic != 0xFFFFFFFFUL))
+    i++;
+  return i;
+}
+
+static int nvm_write(const warmboot_state_t *st) {
+  unsigned int idx = nvm_free_idx();
+  if (idx >= WARMBOOT_NVM_RECORDS)
+    return -1;
+
+  volatile uint32_t *dst =
+      (volatile uint32_t *)(WARMBOOT_NVM_ADDR + idx * sizeof(warmboot_state_t));
+  const uint32_t *src = (const uint32_t *)st;
+
+  NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Wen << NVMC_CONFIG_WEN_Pos;
+  for (unsigned int i = 0; i < sizeof(warmboot_state_t) / 4; i++) {
+    dst[i] = src[i];
+    while (NRF_NVMC->READY == NVMC_READY_READY_Busy) {
+    };
+  }
+  NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Ren << NVMC_CONFIG_WEN_Pos;
+  return 0;
+}
+
+enum WarmbootSource warmboot_restore(void) {
+  /* Don't trust state that may have led to a lockup */
+  bool watchdog = NRF_POWER->RESETREAS & POWER_RESETREAS_DOG_Msk;
+  if (watchdog)
+    NRF_POWER->RESETREAS = POWER_RESETREAS_DOG_Msk;
+
+  if (watchdog || !warmboot_check(&state))
+    state.magic = 0;
+  /* Cleared block stays unsealed, as its checksum doesn't match */
+  if (!retained_init(&state, sizeof(state), WARMBOOT_MAGIC)) {
+    source = WARMBOOT_RAM;
+    return source;
+  }
+
+  nvm_age = UINT32_MAX;
+  source = WARMBOOT_COLD;
+  if (watchdog)
+    return source;
+
+  /* RAM was lost, use latest valid record from NVM */
+  const warmboot_state_t *records = (const warmboot_state_t *)WARMBOOT_NVM_ADDR;
+  unsigned int n_records = nvm_free_idx();
+  for (unsigned int i = 0; i < n_records; i++) {
+    if (warmboot_check(&records[i])) {
+      state = records[i];
+      source = WARMBOOT_NVM;
+    }
+  }
+  return source;
+}
+
+enum WarmbootSource warmboot_source(void) { return source; }
+
+__attribute__((long_call, section(".ramfunctions"))) warmboot_state_t *
+warmboot_state(void) {
+  return &state;
+}
+
+int warmboot_save(void) {
+  state.magic = WARMBOOT_MAGIC;
+  state.crc = warmboot_crc(&state);
+  if (nvm_age < UINT32_MAX)
+    nvm_age++;
+  return 0;
+}
+
+int warmboot_nvm_update(unsigned int max_age) {
+  /* Nothing sealed yet after cold boot */
+  if ((nvm_age < max_age) || !warmboot_check(&state))
+    return 1;
+  if (nvm_write(&state) != 0)
+    return -1;
+  nvm_age = 0;
+  return 0;
+}
+
+int warmboot_nvm_prepare(void) {
+  if (nvm_free_idx() < WARMBOOT_NVM_RECORDS)
+    return 0;
+
+  NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Een << NVMC_CONFIG_WEN_Pos;
+  NRF_NVMC->ERASEPAGE = WARMBOOT_NVM_ADDR;
+  while (NRF_NVMC->READY == NVMC_READY_READY_Busy) {
+  };
+  NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Ren << NVMC_CONFIG_WEN_Pos;
+  return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * Benchmarks CPU wakeups per second of the flync PLL
+ *
+ * Simulates a flicker signal from a drifting and jittering clock, including
+ * MPPT phases where the harvester hides the signal, and runs the PLL on it.
+ * Compares the interrupt driven implementation, which wakes up on every edge
+ * and on every flync tick, to the hardware capture with decimated updates.
+ * The hardware capture routes every RTC tick through PPI to TIMER1, which
+ * draws a constant current on top of the wakeups.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pll.h"
+#include "pll_sim.h"
+
+#define RTC_FREQUENCY 32768.0
+#define FLICKER_FREQ_HZ 100.0
+
+#define SIM_SECONDS 600
+/* Phase errors are only recorded after the PLL had time to settle */
+#define SETTLE_SECONDS 60
+
+/* Frequency error of the RTC with respect to the flicker signal */
+#define DRIFT_PPM 200.0
+/* Peak jitter of flicker edges in RTC ticks */
+#define JITTER_TICKS 0.5
+/* Every MPPT_INTERVAL flicker periods, MPPT_EDGES edges are missing */
+#define MPPT_INTERVAL 1600
+#define MPPT_EDGES 26
+
+/* Estimated charge of one wakeup: about 20us of CPU at 3.7mA from RAM */
+#define WAKEUP_NC 75.0
+/* Estimated current of the RTC TICK feed: the TIMER1 COUNT task requests the
+ * 16MHz peripheral clock for about 1us on each of the 32768 ticks per second,
+ * with HFINT drawing about 60uA while running, plus the TICK event itself */
+#define TICK_FEED_UA 3.0
+
+typedef struct {
+  unsigned long wakeups;
+  double err_sq;
+  unsigned long n_err;
+  int err_max;
+} result_t;
+
+static result_t simulate(unsigned int decim_max, int hw_capture) {
+  result_t res = {0};
+  pll_sim_t sim;
+
+  double t_flicker = RTC_FREQUENCY / FLICKER_FREQ_HZ * (1.0 + DRIFT_PPM / 1e6);
+  unsigned long n_edges = SIM_SECONDS * FLICKER_FREQ_HZ;
+
+  pll_sim_init(&sim, 100, SIM_CLOCK_RTCTICKS, 0, decim_max, hw_capture);
+
+  srand(1);
+  for (unsigned long k = 1; k < n_edges; k++) {
+    double jitter = JITTER_TICKS * (2.0 * rand() / RAND_MAX - 1.0);
+    long edge = (long)floor(100.3 + k * t_flicker + jitter);
+
+    if (k % MPPT_INTERVAL < MPPT_EDGES)
+      continue;
+
+    int err = pll_sim_edge(&sim, edge);
+    if (k > SETTLE_SECONDS * FLICKER_FREQ_HZ) {
+      res.err_sq += err * err;
+      res.n_err++;
+      if (abs(err) > res.err_max)
+        res.err_max = abs(err);
+    }
+  }
+  res.wakeups = sim.wakeups;
+  return res;
+}
+
+static int report(const char *name, unsigned int decim_max, int hw_capture) {
+  result_t res = simulate(decim_max, hw_capture);
+  double wakeups = (double)res.wakeups / SIM_SECONDS;
+  double current = wakeups * WAKEUP_NC / 1000.0;
+  if (hw_capture)
+    current += TICK_FEED_UA;
+  printf("%-12s %6u %12.1f %12.2f %10d %8.1f\n", name, decim_max, wakeups,
+         sqrt(res.err_sq / res.n_err), res.err_max, current);
+
+  /* PLL must stay in lock, i.e. edges must never leave the phase window */
+  return res.err_max < SIM_CLOCK_RTCTICKS / 4 ? 0 : 1;
+}
+
+int main(void) {
+  int rc = 0;
+  printf("%-12s %6s %12s %12s %10s %8s\n", "mode", "decim", "wakeups/s",
+         "rms err", "max err", "est uA");
+  rc |= report("per-edge", 1, 0);
+  for (unsigned int decim = 1; decim <= 16; decim *= 2)
+    rc |= report("hw-capture", decim, 1);
+  return rc;
+}
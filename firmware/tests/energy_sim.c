@@ -0,0 +1,125 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "charge.h"
+#include "energy_sim.h"
+#include "vthr.h"
+
+/* Flync tick of a 100Hz flicker in seconds */
+#define SIM_TICK_S (327.0 / 32768.0)
+
+/* Voltage of an ADC code, inverse of V2ADC */
+#define SIM_ADC2V(x) ((x)*ADC_REF / (1 << ADC_BITS) / (1.0 * ADC_GAIN))
+
+enum SimPhase { SIM_OFF, SIM_CHARGE, SIM_WAIT, SIM_DISCO, SIM_POF };
+
+void energy_sim_defaults(energy_sim_params_t *params) {
+  params->capacitance = 47e-6;
+  /* System ON with RTC and a SAADC conversion per tick */
+  params->p_sleep = 10e-6;
+  /* 5.3uJ of fixed cost and an RX window of 26 RTC ticks at 19.2mW */
+  params->e_round = 5.3e-6 + 19.2e-3 * 26 / 32768.0;
+  params->v_on = 3.3;
+  params->v_max = 3.5;
+  params->v_round = 3.0;
+  params->v_pofwarn = 2.7;
+  params->v_uv = 2.6;
+  params->v_ok = 2.8;
+}
+
+static double sim_voltage(const energy_sim_params_t *params, double energy) {
+  return sqrt(2 * energy / params->capacitance);
+}
+
+void energy_sim_run(const energy_sim_params_t *params, const double *power,
+                    size_t n, int adaptive, energy_sim_result_t *res) {
+  memset(res, 0, sizeof(*res));
+  vthr_init(V2ADC(params->v_on), V2ADC(params->v_round), V2ADC(params->v_max));
+  /* Brownouts are counted from the start of the replay */
+  vthr_backoff(0);
+
+  const double c = params->capacitance;
+  /* BQ25505 stops charging shortly above V_THR_MAX */
+  const double e_full = 0.5 * c * (params->v_max + 0.1) * (params->v_max + 0.1);
+  double energy = 0.5 * c * params->v_ok * params->v_ok;
+  enum SimPhase phase = SIM_CHARGE;
+  unsigned long t_start = 0, t_charge = 0, t_wait = 0;
+  unsigned int v_disco = 0;
+  /* Charging since the power-fail warning */
+  int pof = 0;
+
+  for (unsigned long t = 0; t < n * SIM_POWER_TICKS; t++) {
+    double p_load = (phase == SIM_OFF) ? 0.0 : params->p_sleep;
+    energy += (power[t / SIM_POWER_TICKS] - p_load) * SIM_TICK_S;
+    if (energy > e_full)
+      energy = e_full;
+    if (energy < 0.0)
+      energy = 0.0;
+
+    double v_thr_on = adaptive ? SIM_ADC2V(vthr_get()) : params->v_on;
+    double v = sim_voltage(params, energy);
+    switch (phase) {
+    case SIM_OFF:
+      if (v >= params->v_ok) {
+        /* Boot after brownout */
+        if (adaptive)
+          vthr_backoff(res->brownouts);
+        phase = SIM_CHARGE;
+        t_start = t;
+      }
+      break;
+    case SIM_CHARGE:
+      if (v >= v_thr_on) {
+        pof = 0;
+        t_charge = t - t_start;
+        t_wait = t + rand() % (t_charge + 1);
+        phase = SIM_WAIT;
+      }
+      break;
+    case SIM_WAIT:
+      if ((t < t_wait) && (v < params->v_max))
+        break;
+      /* Conversion of the previous tick selects the window */
+      v_disco = V2ADC(v);
+      res->n_cycles++;
+      res->t_charge += t_charge;
+      res->n_short += (v < params->v_round);
+      energy -= params->e_round;
+      res->n_rounds++;
+      phase = SIM_DISCO;
+      break;
+    case SIM_DISCO:
+      /* Extra rounds on following ticks */
+      if (v >= params->v_round) {
+        energy -= params->e_round;
+        res->n_rounds++;
+        break;
+      }
+      if (adaptive)
+        vthr_adapt(v_disco);
+      phase = SIM_POF;
+      break;
+    case SIM_POF:
+      /* Node sleeps until the warning or until another round was recovered,
+       * and only browns out later if harvesting falls below p_sleep */
+      if ((v < params->v_pofwarn) || (v >= params->v_round)) {
+        phase = SIM_CHARGE;
+        t_start = t;
+        pof = 1;
+      }
+      break;
+    }
+
+    v = sim_voltage(params, (energy > 0.0) ? energy : 0.0);
+    if ((phase != SIM_OFF) && (v < params->v_uv)) {
+      /* Counted like acct, which closes the cycle on the warning */
+      if ((phase == SIM_WAIT) || (phase == SIM_DISCO))
+        res->brownouts++;
+      else if (pof)
+        res->brownouts_pof++;
+      phase = SIM_OFF;
+    }
+  }
+  res->t_total = n * SIM_POWER_TICKS;
+}
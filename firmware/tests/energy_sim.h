@@ -0,0 +1,73 @@
+#ifndef __ENERGY_SIM_H_
+#define __ENERGY_SIM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Harvested power traces are sampled every this many flync ticks, i.e. 0.1s */
+#define SIM_POWER_TICKS 10
+
+/* Node parameters, see ../model/neslab/find/energy.py */
+typedef struct {
+  /* Storage capacitor in F */
+  double capacitance;
+  /* Supply power while sleeping in W */
+  double p_sleep;
+  /* Energy of a discovery round in J */
+  double e_round;
+  /* Thresholds of main.c in V */
+  double v_on;
+  double v_max;
+  double v_round;
+  double v_pofwarn;
+  /* Charger disconnects the node below v_uv and reconnects above v_ok */
+  double v_uv;
+  double v_ok;
+} energy_sim_params_t;
+
+typedef struct {
+  /* Cycles that started discovery and rounds in total */
+  unsigned long n_cycles;
+  unsigned long n_rounds;
+  /* Total charging time in flync ticks */
+  unsigned long t_charge;
+  /* Cycles whose first round started below v_round */
+  unsigned long n_short;
+  /* Brownouts during waiting and discovery */
+  unsigned long brownouts;
+  /* Brownouts while charging after the power-fail warning, not counted by
+   * acct and not seen by vthr */
+  unsigned long brownouts_pof;
+  /* Simulated time in flync ticks */
+  unsigned long t_total;
+} energy_sim_result_t;
+
+/**
+ * Default parameters of the FLYNC node
+ *
+ * @param params Parameters to fill in
+ *
+ */
+void energy_sim_defaults(energy_sim_params_t *params);
+
+/**
+ * Replays a harvested power trace through charging cycles of protocol()
+ *
+ * Integrates the capacitor energy on every flync tick. Waiting times are
+ * uniform up to the charging time, extra rounds follow on consecutive ticks
+ * as long as the voltage stays above v_round. The node then sleeps until the
+ * power-fail warning or until the voltage recovered to v_round, and browns
+ * out afterwards if harvesting doesn't cover p_sleep. With adaptive set, the
+ * turn-on threshold is controlled by vthr, otherwise it stays at v_on.
+ *
+ * @param params Node parameters
+ * @param power Harvested power in W, one sample per SIM_POWER_TICKS ticks
+ * @param n Number of samples
+ * @param adaptive 1 to adapt the turn-on threshold, 0 for a fixed one
+ * @param res Results
+ *
+ */
+void energy_sim_run(const energy_sim_params_t *params, const double *power,
+                    size_t n, int adaptive, energy_sim_result_t *res);
+
+#endif /* __ENERGY_SIM_H_ */
@@ -0,0 +1,97 @@
+#include <stdint.h>
+
+#include "pll.h"
+#include "pll_sim.h"
+#include "trace.h"
+
+/* Advances the virtual clock recorded by trace points to time t */
+static void sim_clock(pll_sim_t *sim, long t) {
+  trace_host_clock((uint32_t)(t * SIM_CYCLES_PER_RTCTICK),
+                   (uint32_t)(t - sim->boundary));
+}
+
+void pll_sim_init(pll_sim_t *sim, long first_edge, unsigned int period,
+                  int32_t freq, unsigned int decim_max, int hw_capture) {
+  pll_init(&sim->pll, period, freq, hw_capture ? decim_max : 1);
+  sim->hw_capture = hw_capture;
+  sim->period = period;
+  /* RTC is cleared on a rising edge, about half a period before the falling
+   * edges that are tracked */
+  sim->boundary = first_edge - period / 2;
+  sim->now = 1;
+  sim->t_last_update = 0;
+  sim->n_counted = 0;
+  sim->n_edges = 0;
+  sim->edge_detected = 0;
+  sim->masked = 0;
+  sim->tick_irq = 0;
+  sim->wakeups = 0;
+}
+
+static void sim_tick(pll_sim_t *sim) {
+  sim->boundary += sim->period;
+  sim->now++;
+  sim_clock(sim, sim->boundary);
+  if (sim->hw_capture) {
+    /* _flync_tick */
+    if (!sim->tick_irq)
+      return;
+    sim->wakeups++;
+    if (pll_holdover(&sim->pll, sim->now))
+      sim->period = pll_freerun(&sim->pll);
+    else if (!pll_holdover(&sim->pll, sim->now + 2 * sim->pll.decim))
+      sim->tick_irq = 0;
+    return;
+  }
+
+  /* SAADC_IRQHandler */
+  sim->wakeups++;
+  sim->masked = pll_holdover(&sim->pll, sim->now);
+  if (!sim->edge_detected)
+    sim->period = pll_freerun(&sim->pll);
+  sim->edge_detected = 0;
+}
+
+int pll_sim_edge(pll_sim_t *sim, long edge) {
+  while (sim->boundary + (long)sim->period <= edge)
+    sim_tick(sim);
+
+  unsigned int phase = edge - sim->boundary;
+  sim_clock(sim, edge);
+  int err = (int)phase - (int)sim->period / 2;
+
+  unsigned int period;
+  if (sim->hw_capture) {
+    /* TIMER2_IRQHandler */
+    if (++sim->n_counted < sim->pll.decim)
+      return err;
+    sim->wakeups++;
+    sim->n_edges += sim->n_counted;
+    sim->n_counted = 0;
+    if (pll_holdover(&sim->pll, sim->now))
+      return err;
+    period = pll_update(&sim->pll, phase, sim->now - sim->t_last_update,
+                        sim->n_edges, sim->now);
+    if (period == 0)
+      return err;
+    if (pll_holdover(&sim->pll, sim->now + 2 * sim->pll.decim))
+      sim->tick_irq = 1;
+  } else {
+    /* GPIOTE_IRQHandler */
+    if (sim->masked)
+      return err;
+    sim->wakeups++;
+    if (sim->edge_detected)
+      return err;
+    sim->n_edges++;
+    period = pll_update(&sim->pll, phase, sim->now - sim->t_last_update,
+                        sim->n_edges, sim->now);
+    if (period == 0)
+      return err;
+    sim->edge_detected = 1;
+  }
+  sim->period = period;
+  sim->t_last_update = sim->now;
+  sim->n_edges = 0;
+  return err;
+}
@@ -0,0 +1,63 @@
+#ifndef __PLL_SIM_H_
+#define __PLL_SIM_H_
+
+#include <stdint.h>
+
+#include "pll.h"
+
+/* Nominal flync period of a 100Hz flicker on the 32768Hz RTC */
+#define SIM_CLOCK_RTCTICKS 327
+/* Virtual CPU clock of 64MHz, for the cycle count recorded by trace points */
+#define SIM_CYCLES_PER_RTCTICK (64000000.0 / 32768.0)
+
+/*
+ * Models the RTC, edge capture and interrupt handlers of flync.c. Trace
+ * points record the simulated time, so interrupt handlers take no time.
+ */
+typedef struct {
+  pll_t pll;
+  /* Capture edges in hardware or wake up on every edge and tick */
+  int hw_capture;
+  /* Current period register and start of the current period in RTC ticks */
+  unsigned int period;
+  long boundary;
+  /* System time in flync ticks */
+  uint32_t now;
+  uint32_t t_last_update;
+  /* Edges counted since last wakeup and since last update */
+  unsigned int n_counted;
+  unsigned int n_edges;
+  /* Interrupt driven only: valid edge in current period, edges masked */
+  int edge_detected;
+  int masked;
+  /* Hardware capture only: tick interrupt enabled for holdover */
+  int tick_irq;
+  /* Number of CPU wakeups */
+  unsigned long wakeups;
+} pll_sim_t;
+
+/**
+ * Initializes simulation after calibration
+ *
+ * @param sim Simulation state
+ * @param first_edge Time of the first tracked edge in RTC ticks
+ * @param period Calibrated period in RTC ticks
+ * @param freq Period estimate restored after a brownout, 0 for cold boot
+ * @param decim_max Maximum decimation, only used with hardware capture
+ * @param hw_capture 1 to model hardware capture, 0 for interrupt driven
+ *
+ */
+void pll_sim_init(pll_sim_t *sim, long first_edge, unsigned int period,
+                  int32_t freq, unsigned int decim_max, int hw_capture);
+
+/**
+ * Advances simulation to the next flicker edge
+ *
+ * @param sim Simulation state
+ * @param edge Time of edge in RTC ticks
+ *
+ * @returns Phase error of the edge in RTC ticks with respect to half period
+ */
+int pll_sim_edge(pll_sim_t *sim, long edge);
+
+#endif /* __PLL_SIM_H_ */
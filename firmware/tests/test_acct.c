@@ -0,0 +1,110 @@
+/*
+ * Checks the accounting report against the log ring
+ *
+ * Charging cycles of fixed phase durations are accounted on a virtual clock
+ * until a report is due. The report and the records of one cycle with a full
+ * round of discovery results must fit into the log ring without dropping a
+ * record, and the report must carry the counts and durations of every phase.
+ */
+#include <stdint.h>
+#include <stdio.h>
+
+#include "acct.h"
+#include "log.h"
+#include "neighbor.h"
+
+/* Results a round can queue, DISCO_RX_BUFS in disco.h */
+#define N_RESULTS 4
+
+/* Duration of the phases in RTC ticks */
+static const uint32_t durations[ACCT_N_PHASES] = {3000, 700, 40, 90};
+
+static uint32_t now, rtc;
+
+static void advance(uint32_t rtc_tcks) {
+  rtc += rtc_tcks;
+  now += rtc / ACCT_HOST_PERIOD;
+  rtc %= ACCT_HOST_PERIOD;
+  acct_host_clock(now, rtc);
+  log_host_clock(now);
+}
+
+/* Records that protocol() writes in a cycle with a full round of results */
+static void log_cycle(void) {
+  for (unsigned int i = 0; i < N_RESULTS; i++) {
+    for (unsigned int j = 0; j < NBR_TWO_HOP; j++)
+      log_printf("gossip %08X hears %04X\n", 0x1000 + i, 0x2000 + j);
+    log_printf("disco %08X type %u rssi %u t_chr %u\n", 0x1000 + i, 0, 60, 20);
+  }
+  log_printf("cycle t_chr %u rounds %u meet %u\n", 20, 3, 0);
+  log_printf("txpwr %d heard %u\n", 0, N_RESULTS);
+  log_printf("hfclk lead %u late %u\n", 18, 0);
+  log_printf("thr_on %u v_disco %u\n", 900, 920);
+}
+
+static int test_report(void) {
+  uint32_t words[LOG_BUF_WORDS];
+  unsigned int n_words = 0;
+
+  acct_init();
+  for (unsigned int c = 0; c < ACCT_REPORT_CYCLES; c++) {
+    for (unsigned int p = 0; p < ACCT_N_PHASES; p++) {
+      advance(durations[p]);
+      acct_enter((p + 1) % ACCT_N_PHASES);
+    }
+    /* Drain all but the last cycle, as the UARTE would on surplus energy */
+    if (c < ACCT_REPORT_CYCLES - 1) {
+      acct_report();
+      while (log_host_read(words, LOG_BUF_WORDS) > 0)
+        ;
+    }
+  }
+  log_cycle();
+  acct_report();
+  n_words = log_host_read(words, LOG_BUF_WORDS);
+
+  unsigned int n_report = 0, i = 0;
+  while (i < n_words) {
+    unsigned int nargs = (words[i] >> 20) & 0xF;
+    if ((words[i] >> 24) != LOG_MAGIC) {
+      printf("FAIL: no record header at word %u\n", i);
+      return 1;
+    }
+    if ((words[i] & 0xFFFFF) == LOG_ID_DROPPED) {
+      printf("FAIL: %u records dropped\n", words[i + 2]);
+      return 1;
+    }
+    /* Phase records: phase, count, duration, brownouts and two bins */
+    if ((nargs == 6) && (i + 7 < n_words) &&
+        (words[i + 2] < ACCT_N_PHASES)) {
+      unsigned int p = words[i + 2];
+      if ((words[i + 3] != ACCT_REPORT_CYCLES) ||
+          (words[i + 4] != ACCT_REPORT_CYCLES * durations[p]) ||
+          (words[i + 5] != 0)) {
+        printf("FAIL: phase %u reports n %u rtc %u brownouts %u\n", p,
+               words[i + 3], words[i + 4], words[i + 5]);
+        return 1;
+      }
+      n_report++;
+    }
+    i += 2 + nargs;
+  }
+  if (n_report != ACCT_N_PHASES) {
+    printf("FAIL: report has %u phase records\n", n_report);
+    return 1;
+  }
+  if (ACCT_REPORT_WORDS > LOG_BUF_WORDS / 4) {
+    printf("FAIL: report takes %u of %u words\n", ACCT_REPORT_WORDS,
+           LOG_BUF_WORDS);
+    return 1;
+  }
+  printf("%-10s %6u %8u %8u\n", "report", ACCT_REPORT_CYCLES,
+         ACCT_REPORT_WORDS, n_words);
+  return 0;
+}
+
+int main(void) {
+  /* Cycles until the report, words of the report and of the whole cycle */
+  printf("%-10s %6s %8s %8s\n", "test", "cycles", "report", "words");
+  return test_report();
+}
@@ -0,0 +1,74 @@
+/*
+ * Checks the density estimate
+ *
+ * Nodes of a clique wake up once per cycle in a random slot and hear every
+ * neighbor that wakes up in the same slot. The estimate must converge to the
+ * size of the clique for long and short cycles. A single neighbor that is
+ * heard once after a long silence must not inflate it.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "density.h"
+
+#define N_CYCLES 200000
+
+static double estimate(void) {
+  return (double)density_get() / (1 << DENSITY_FRAC_BITS);
+}
+
+static int test_clique(unsigned int n_nodes, unsigned int cycle_tcks) {
+  double sum = 0.0;
+  unsigned int n_avg = 0;
+  for (unsigned int c = 0; c < N_CYCLES; c++) {
+    /* Each neighbor is active in our slot with probability 1/cycle_tcks */
+    for (unsigned int i = 1; i < n_nodes; i++) {
+      if (rand() % cycle_tcks == 0)
+        density_count(LA_BCN);
+    }
+    density_update(cycle_tcks, 1);
+    if (c >= N_CYCLES / 2) {
+      sum += estimate();
+      n_avg++;
+    }
+  }
+  double avg = sum / n_avg;
+  printf("clique %9u %8u %8.2f\n", n_nodes, cycle_tcks, avg);
+  if ((avg < 0.8 * n_nodes) || (avg > 1.2 * n_nodes)) {
+    printf("FAIL: estimated %.2f nodes instead of %u\n", avg, n_nodes);
+    return 1;
+  }
+  return 0;
+}
+
+static int test_single(unsigned int cycle_tcks) {
+  /* Two nodes, the neighbor is heard once in a long cycle */
+  for (unsigned int c = 0; c < 100; c++)
+    density_update(cycle_tcks, 1);
+  density_count(LA_BCN);
+  density_count(LA_ACK_YES);
+  density_update(cycle_tcks, 1);
+  double est = estimate();
+  printf("single %9u %8u %8.2f\n", 2, cycle_tcks, est);
+  if ((est < 1.5) || (est > 2.5)) {
+    printf("FAIL: single packet moved estimate to %.2f\n", est);
+    return 1;
+  }
+  return 0;
+}
+
+int main(void) {
+  srand(1);
+  int rc = 0;
+  density_init();
+  /* Clique size and average estimate over the second half of the cycles */
+  printf("%-6s %9s %8s %8s\n", "test", "nodes", "cycle", "estimate");
+  rc |= test_single(100);
+  rc |= test_single(1000);
+  rc |= test_clique(2, 20);
+  rc |= test_clique(8, 20);
+  rc |= test_clique(8, 200);
+  rc |= test_clique(32, 50);
+  return rc;
+}
@@ -0,0 +1,91 @@
+/*
+ * Checks HFCLK startup calibration
+ *
+ * Startup latencies of the crystal are drawn around a mean with jitter and
+ * rare slow startups. The lead must shrink from HFCLK_LEAD_MAX to little more
+ * than the slowest recent startups, keep the beacon on its phase for almost
+ * every round, follow a sudden increase of the latency, e.g. after a drop in
+ * temperature, and survive a warm boot.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hfclk.h"
+
+#define N_ROUNDS 100000
+
+/* Rounds whose HFCLK started too late, per mille */
+#define MAX_LATE_PERMILLE 5
+
+/* Startup latency in RTC ticks, one in 128 startups takes 4 ticks longer */
+static unsigned int latency(unsigned int mean) {
+  unsigned int l = mean - 1 + rand() % 3;
+  return (rand() % 128 == 0) ? l + 4 : l;
+}
+
+static int run(const char *name, unsigned int mean) {
+  unsigned long n_late = 0, lead_sum = 0;
+  for (unsigned int i = 0; i < N_ROUNDS; i++) {
+    unsigned int lead = hfclk_lead();
+    unsigned int l = latency(mean);
+    n_late += (l >= lead);
+    lead_sum += lead;
+    hfclk_update(l);
+  }
+  double lead_avg = (double)lead_sum / N_ROUNDS;
+  printf("%-10s %6u %8.1f %8lu\n", name, mean, lead_avg, n_late);
+
+  if (n_late * 1000 > N_ROUNDS * MAX_LATE_PERMILLE) {
+    printf("FAIL: %lu late startups\n", n_late);
+    return 1;
+  }
+  /* Lead may exceed the slowest startups only by the guard and decay */
+  if (lead_avg > mean + 5 + HFCLK_GUARD_TCKS + 2) {
+    printf("FAIL: lead of %.1f ticks\n", lead_avg);
+    return 1;
+  }
+  return 0;
+}
+
+static int test_step(void) {
+  for (unsigned int i = 0; i < 1000; i++)
+    hfclk_update(10);
+  /* Crystal got slower, only the first startup may be late */
+  unsigned int n_late = 0;
+  for (unsigned int i = 0; i < 1000; i++) {
+    n_late += (16 >= hfclk_lead());
+    hfclk_update(16);
+  }
+  printf("%-10s %6u %8u %8u\n", "step", 16, hfclk_lead(), n_late);
+  if (n_late > 1) {
+    printf("FAIL: %u late startups after step\n", n_late);
+    return 1;
+  }
+  return 0;
+}
+
+static int test_boot(void) {
+  unsigned int lead = hfclk_lead();
+  if ((hfclk_init() != 0) || (hfclk_lead() != lead)) {
+    printf("FAIL: calibration lost at warm boot\n");
+    return 1;
+  }
+  printf("%-10s %6s %8u %8u\n", "boot", "-", lead, 0);
+  return 0;
+}
+
+int main(void) {
+  srand(1);
+  int rc = 0;
+  if ((hfclk_init() != 1) || (hfclk_lead() != HFCLK_LEAD_MAX)) {
+    printf("FAIL: lead after cold boot is %u\n", hfclk_lead());
+    return 1;
+  }
+  /* Mean latency and average lead in RTC ticks */
+  printf("%-10s %6s %8s %8s\n", "test", "mean", "lead", "late");
+  rc |= run("fast", 9);
+  rc |= run("slow", 20);
+  rc |= test_step();
+  rc |= test_boot();
+  return rc;
+}
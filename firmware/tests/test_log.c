@@ -0,0 +1,88 @@
+/*
+ * Writes log records for a round trip through log_decode.py
+ *
+ * Logs statements with the supported conversions into the ring and takes the
+ * words out like draining over UARTE would. The raw words are written to the
+ * first path and the text the decoder must reconstruct, formatted by the host
+ * printf, to the second one. The ring is also overrun, so that the decoder
+ * sees a record of dropped records.
+ */
+#include <stdint.h>
+#include <stdio.h>
+
+#include "log.h"
+
+/* Logs a statement and writes the expected line of the decoder */
+#define LOG_CHECK(f, fmt, ...)                                                 \
+  do {                                                                         \
+    log_printf(fmt, ##__VA_ARGS__);                                            \
+    fprintf(f, "%10u " fmt, now, ##__VA_ARGS__);                               \
+  } while (0)
+
+static uint32_t now;
+
+static int drain(FILE *bin) {
+  uint32_t words[64];
+  unsigned int n;
+  while ((n = log_host_read(words, 64)) > 0) {
+    if (fwrite(words, sizeof(uint32_t), n, bin) != n)
+      return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s LOG_BIN EXPECTED_TXT\n", argv[0]);
+    return 1;
+  }
+  FILE *bin = fopen(argv[1], "wb");
+  FILE *txt = fopen(argv[2], "w");
+  if ((bin == NULL) || (txt == NULL)) {
+    printf("FAIL: cannot open output files\n");
+    return 1;
+  }
+
+  int rc = 0;
+  unsigned int n_records = 0;
+  int neg = -1234;
+  unsigned int big = 4000000000u;
+
+  log_host_clock(now = 1);
+  LOG_CHECK(txt, "boot\n");
+  LOG_CHECK(txt, "signed %d %i unsigned %u\n", neg, 42, big);
+  LOG_CHECK(txt, "hex %x %X %08x char %c percent %%\n", 0xbeef, 0xBEEF, 0x12,
+            'k');
+  log_host_clock(now = 4294967295u);
+  LOG_CHECK(txt, "six %u %u %u %u %u %d\n", 1, 2, 3, 4, 5, -6);
+  n_records += 4;
+  rc |= drain(bin);
+
+  /* Overrun the ring without draining, the first record after draining
+   * reports the dropped ones */
+  log_host_clock(now = 100);
+  unsigned int n_fit = 0;
+  for (unsigned int i = 0; i < LOG_BUF_WORDS / 3 + 8; i++) {
+    log_printf("fill %u\n", i);
+    /* Every record takes header, time and one argument */
+    if (3 * (i + 1) <= LOG_BUF_WORDS) {
+      fprintf(txt, "%10u fill %u\n", now, i);
+      n_fit++;
+    }
+  }
+  rc |= drain(bin);
+  unsigned int n_dropped = LOG_BUF_WORDS / 3 + 8 - n_fit;
+  log_host_clock(now = 101);
+  log_printf("after %u\n", n_dropped);
+  fprintf(txt, "%10u <%u records dropped>\n", now, n_dropped);
+  fprintf(txt, "%10u after %u\n", now, n_dropped);
+  n_records += n_fit + 2;
+  rc |= drain(bin);
+
+  fclose(bin);
+  fclose(txt);
+  if (rc != 0)
+    printf("FAIL: cannot write %s\n", argv[1]);
+  printf("%-8s %10u %10u\n", "log", n_records, n_dropped);
+  return rc;
+}
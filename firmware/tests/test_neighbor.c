@@ -0,0 +1,189 @@
+/*
+ * Checks planning of meetings with known neighbors
+ *
+ * Both sides of a link plan their meeting from their own system time. The
+ * table keeps one entry per side of the link, with system times of the two
+ * sides offset by a constant, and the planned meetings must refer to the same
+ * slot. Missed meetings are replayed with random charging times around the
+ * wraparound of the 32-bit system time. Gossip must advertise the most
+ * recently heard neighbors.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "neighbor.h"
+
+#define N_LINKS 10000
+#define N_CYCLES 100000
+
+#define ID_A 0x1000
+#define ID_B 0x2000
+
+static int test_agree(uint32_t base) {
+  unsigned int n_aligned = 0;
+  for (unsigned int i = 0; i < N_LINKS; i++) {
+    /* Offset of B's system time from A's */
+    uint32_t offset = rand();
+    uint32_t now_a = base + rand() % 1000;
+    uint32_t now_b = now_a + offset;
+    uint16_t t_chr_a = 1 + rand() % 200;
+    uint16_t t_chr_b = 1 + rand() % 200;
+
+    uint32_t next_a = nbr_plan(now_a, t_chr_a);
+    uint32_t next_b = nbr_plan(now_b, t_chr_b);
+    /* Own plan must be feasible after charging */
+    if ((int32_t)(next_a - now_a) < t_chr_a) {
+      printf("FAIL: planned wakeup before end of charging\n");
+      return 1;
+    }
+    n_aligned += (next_a - now_a) != t_chr_a + (t_chr_a >> NBR_PLAN_SHIFT);
+
+    /* A hears B and B hears A, each translates the peer's plan */
+    nbr_entry_t *b = nbr_update(ID_B + i, 60, t_chr_b);
+    nbr_schedule(b, next_a, next_b - offset, t_chr_a);
+    nbr_entry_t *a = nbr_update(ID_A + i, 60, t_chr_a);
+    nbr_schedule(a, next_b, next_a + offset, t_chr_b);
+
+    if ((a->t_meet != b->t_meet + offset) ||
+        (a->meet_intvl != b->meet_intvl)) {
+      printf("FAIL: sides disagree on meeting %u %u\n", a->t_meet - offset,
+             b->t_meet);
+      return 1;
+    }
+    nbr_age();
+  }
+  printf("agree %17u %10u %8u\n", base, N_LINKS, n_aligned);
+  return 0;
+}
+
+static int test_miss(uint32_t base) {
+  nbr_entry_t *b = nbr_update(ID_B, 60, 20);
+  uint32_t now = base;
+  nbr_schedule(b, nbr_plan(now, 20), now + 25, 20);
+
+  unsigned int n_met = 0, n_lost = 0;
+  for (unsigned int c = 0; c < N_CYCLES; c++) {
+    /* Charging takes shorter or longer than planned */
+    now += 1 + rand() % 60;
+    unsigned int meet_left = b->meet_left;
+    uint32_t t_meet;
+    int rc = nbr_meeting(now, &t_meet);
+    if ((rc == 0) && ((int32_t)(t_meet - now) <= 0)) {
+      printf("FAIL: meeting in the past\n");
+      return 1;
+    }
+    if (b->meet_left > NBR_MEET_RETRIES + 1) {
+      printf("FAIL: meeting retried %u times\n", b->meet_left);
+      return 1;
+    }
+
+    if (rc != 0) {
+      /* Link lost, rediscover after a random wait */
+      n_lost++;
+      now += rand() % 20;
+    } else {
+      now = t_meet;
+      /* Peer missed as well and retries in the same slot, or not */
+      if ((b->meet_left != meet_left) && (rand() % 2))
+        continue;
+      n_met++;
+    }
+    nbr_update(ID_B, 60, 20);
+    nbr_schedule(b, nbr_plan(now, 20), now + 30, 20);
+    nbr_age();
+  }
+  printf("miss %18u %10u %8u\n", base, n_met, n_lost);
+  return 0;
+}
+
+static int test_gossip(void) {
+  uint16_t ids[NBR_TWO_HOP + 2];
+  uint32_t own_id = 0x3000;
+
+  /* Neighbors heard in consecutive cycles, the last one most recently */
+  for (unsigned int i = 0; i < NBR_TWO_HOP + 2; i++) {
+    nbr_age();
+    nbr_update(ID_A + i, 60, 20);
+  }
+  unsigned int n = nbr_recent(ids, NBR_TWO_HOP + 2);
+  for (unsigned int i = 0; i < n; i++) {
+    if (ids[i] != nbr_short_id(ID_A + NBR_TWO_HOP + 1 - i)) {
+      printf("FAIL: gossip %u is %04X\n", i, ids[i]);
+      return 1;
+    }
+  }
+
+  /* Receiver drops its own ID and keeps the rest */
+  ids[1] = nbr_short_id(own_id);
+  nbr_entry_t *b = nbr_update(ID_B, 60, 20);
+  nbr_gossip(b, ids, n, own_id);
+  for (unsigned int i = 0; i < NBR_TWO_HOP; i++) {
+    if (b->two_hop[i] != ids[(i == 0) ? 0 : i + 1]) {
+      printf("FAIL: two-hop neighbor %u is %04X\n", i, b->two_hop[i]);
+      return 1;
+    }
+  }
+  printf("gossip %16s %10u %8u\n", "-", n, NBR_TWO_HOP);
+  return 0;
+}
+
+static int test_boot(void) {
+  nbr_entry_t *b = nbr_update(ID_B, 60, 20);
+  nbr_schedule(b, 100, 120, 20);
+  uint32_t t_meet = 0;
+  if ((nbr_meeting(100, &t_meet) != 0) || (t_meet != 120)) {
+    printf("FAIL: meeting not planned\n");
+    return 1;
+  }
+  /* Meeting is missed and retried, the node browns out before the retry */
+  if ((nbr_meeting(125, &t_meet) != 0) || (b->meet_left != NBR_MEET_RETRIES)) {
+    printf("FAIL: missed meeting not retried\n");
+    return 1;
+  }
+  uint16_t rssi = b->rssi;
+
+  /* System time restarts after boot, the retry can't be placed anymore */
+  nbr_init();
+  b = nbr_lookup(ID_B);
+  if ((b == NULL) || (b->rssi != rssi) || (b->t_chr != 20)) {
+    printf("FAIL: neighbor lost in brownout\n");
+    return 1;
+  }
+  if ((nbr_meeting(0, &t_meet) == 0) || (nbr_plan(0, 20) != 20 + (20 >> 1))) {
+    printf("FAIL: meeting survived brownout\n");
+    return 1;
+  }
+
+  /* Peer kept running, both sides plan anew when they hear each other */
+  uint32_t offset = 5000;
+  uint32_t now = 40;
+  uint32_t next_own = nbr_plan(now, 20);
+  uint32_t next_peer = now + offset + 33;
+  nbr_update(ID_B, 60, 20);
+  nbr_schedule(b, next_own, next_peer - offset, 20);
+  nbr_entry_t *a = nbr_update(ID_A, 60, 20);
+  nbr_schedule(a, next_peer, next_own + offset, 20);
+  if ((a->t_meet != b->t_meet + offset) || (b->meet_left == 0)) {
+    printf("FAIL: no new meeting after brownout\n");
+    return 1;
+  }
+  printf("boot %18s %10u %8u\n", "-", 1, 0);
+  return 0;
+}
+
+int main(void) {
+  srand(1);
+  int rc = 0;
+  nbr_init();
+  /* Number of links or of met and lost meetings */
+  printf("%-10s %12s %10s %8s\n", "test", "base", "count", "other");
+  rc |= test_agree(1);
+  /* System time wraps around during the test */
+  rc |= test_agree(UINT32_MAX - 500);
+  rc |= test_miss(1);
+  rc |= test_miss(UINT32_MAX - 1000);
+  rc |= test_gossip();
+  rc |= test_boot();
+  return rc;
+}
@@ -0,0 +1,125 @@
+/*
+ * Replays flicker edge traces through the PLL
+ *
+ * Traces contain timestamps of flicker edges in RTC ticks of a node, one per
+ * line. Lines starting with '#' are comments. The first two edges give the
+ * period that flync_init measures between rising edges. Every trace is
+ * replayed with interrupt driven updates and with hardware capture, checking
+ * how many edges it takes to lock and how far the phase deviates afterwards,
+ * including MPPT gaps. Traces are also replayed from a stale estimate of the
+ * other flicker rate, as restored after a brownout under a different lamp.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pll.h"
+#include "pll_sim.h"
+#include "trace_load.h"
+
+#define TRACE_MAX_EDGES 65536
+
+/* PLL must lock within this many edges */
+#define LOCK_EDGES 100
+/* Starting from a stale estimate, the PLL must lock within this many edges */
+#define LOCK_EDGES_STALE 200
+/* Locked after this many consecutive edges within PLL_LOCK_THR */
+#define LOCK_RUN 16
+/* Maximum phase error after lock in RTC ticks */
+#define MAX_ERR 16
+/* Traces may contain spurious edges, which are not held to MAX_ERR. At most
+ * this many per mille of the edges may exceed it. */
+#define MAX_OUTLIERS_PERMILLE 2
+
+static double values[TRACE_MAX_EDGES];
+static long edges[TRACE_MAX_EDGES];
+
+static int replay(const char *path, size_t n, unsigned int decim_max,
+                  int hw_capture, int stale) {
+  pll_sim_t sim;
+  unsigned int period = edges[1] - edges[0];
+  int32_t freq = 0;
+  unsigned int lock_edges = LOCK_EDGES;
+  if (stale) {
+    /* Restored estimate and period register of the other flicker rate */
+    unsigned int rate = (pll_rate((int32_t)period << PLL_FRAC_BITS) == 100)
+                            ? 120
+                            : 100;
+    freq = (int32_t)((PLL_RTC_FREQUENCY << PLL_FRAC_BITS) / rate);
+    period = (freq + (1 << (PLL_FRAC_BITS - 1))) >> PLL_FRAC_BITS;
+    lock_edges = LOCK_EDGES_STALE;
+  }
+  pll_sim_init(&sim, edges[1], period, freq, decim_max, hw_capture);
+
+  size_t lock_edge = 0;
+  unsigned int run = 0;
+  unsigned long n_err = 0, n_outliers = 0;
+  double err_sq = 0.0;
+  int err_max = 0;
+
+  for (size_t i = 2; i < n; i++) {
+    int err = pll_sim_edge(&sim, edges[i]);
+
+    if (lock_edge == 0) {
+      run = (abs(err) <= PLL_LOCK_THR) ? run + 1 : 0;
+      if (run >= LOCK_RUN)
+        lock_edge = i;
+      continue;
+    }
+    if (abs(err) > MAX_ERR) {
+      n_outliers++;
+      continue;
+    }
+    n_err++;
+    err_sq += err * err;
+    if (abs(err) > err_max)
+      err_max = abs(err);
+  }
+
+  printf("%-40s %-10s %-5s %5u %6zu %8.2f %7d %7lu %8u\n", path,
+         hw_capture ? "hw-capture" : "per-edge", stale ? "stale" : "cold",
+         decim_max, lock_edge,
+         n_err ? sqrt(err_sq / n_err) : 0.0, err_max, n_outliers,
+         sim.pll.gap_hits >= PLL_GAP_HITS ? sim.pll.gap_interval : 0);
+
+  int rc = 0;
+  if ((lock_edge == 0) || (lock_edge > lock_edges)) {
+    printf("FAIL: no lock within %u edges\n", lock_edges);
+    rc = 1;
+  }
+  if (n_outliers * 1000 > (n_err + n_outliers) * MAX_OUTLIERS_PERMILLE) {
+    printf("FAIL: %lu edges exceed %d ticks phase error\n", n_outliers,
+           MAX_ERR);
+    rc = 1;
+  }
+  return rc;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s TRACE...\n", argv[0]);
+    return 1;
+  }
+
+  int rc = 0;
+  printf("%-40s %-10s %-5s %5s %6s %8s %7s %7s %8s\n", "trace", "mode",
+         "start", "decim", "lock", "rms err", "max err", "outlier", "gap");
+  for (int i = 1; i < argc; i++) {
+    size_t n = trace_load(argv[i], values, TRACE_MAX_EDGES);
+    for (size_t j = 0; j < n; j++)
+      edges[j] = (long)values[j];
+    if (n < 3) {
+      printf("FAIL: %s has too few edges\n", argv[i]);
+      rc = 1;
+      continue;
+    }
+    rc |= replay(argv[i], n, 1, 0, 0);
+    for (unsigned int decim = 1; decim <= 8; decim *= 2)
+      rc |= replay(argv[i], n, decim, 1, 0);
+    /* Acquisition always runs without decimation, which only starts after
+     * lock and is covered from cold boot */
+    rc |= replay(argv[i], n, 1, 0, 1);
+    rc |= replay(argv[i], n, 1, 1, 1);
+  }
+  return rc;
+}
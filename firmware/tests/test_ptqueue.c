@@ -0,0 +1,147 @@
+/*
+ * Stress test of the pt.h queue and events across threads
+ *
+ * A producer thread stands in for an interrupt handler and hands elements
+ * and events to a consumer thread standing in for the protothread context.
+ * Elements carry a sequence number and its complement, so that reordered,
+ * lost, duplicated or torn elements are detected. The producer alternates
+ * between pushing copies and filling slots in place. Waiting threads yield, so
+ * that the test also makes progress on a single core.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "pt.h"
+
+#define N_ELEMENTS 5000000
+#define N_EVENTS 1000000
+/* Give up waiting after this many seconds */
+#define TIMEOUT_S 20
+
+typedef struct {
+  uint32_t seq;
+  uint32_t check;
+  uint32_t payload[6];
+} element_t;
+
+static pt_queue(element_t, 16) queue = pt_queue_init();
+
+static pt_event_t data_evt = pt_event_init();
+static pt_event_t ack_evt = pt_event_init();
+/* Written before data_evt is set, read after it is taken */
+static uint32_t data;
+
+static time_t deadline;
+
+static int timed_out(void) { return time(NULL) > deadline; }
+
+static void *queue_producer(void *arg) {
+  (void)arg;
+  for (uint32_t seq = 0; seq < N_ELEMENTS; seq++) {
+    element_t el = {.seq = seq, .check = ~seq};
+    for (unsigned int i = 0; i < 6; i++)
+      el.payload[i] = seq * (i + 1);
+    element_t *slot;
+    while ((seq & 1) ? ((slot = pt_queue_tail(&queue)) == NULL)
+                     : !pt_queue_push(&queue, el)) {
+      if (timed_out())
+        return NULL;
+      sched_yield();
+    }
+    if (seq & 1) {
+      *slot = el;
+      pt_queue_commit(&queue);
+    }
+  }
+  return NULL;
+}
+
+static int test_queue(void) {
+  pthread_t producer;
+  pthread_create(&producer, NULL, queue_producer, NULL);
+
+  int rc = 0;
+  unsigned long n_empty = 0;
+  for (uint32_t seq = 0; seq < N_ELEMENTS;) {
+    element_t *el = pt_queue_peek(&queue);
+    if (el == NULL) {
+      n_empty++;
+      if (timed_out()) {
+        printf("FAIL: queue stalled at element %u\n", seq);
+        rc = 1;
+        break;
+      }
+      sched_yield();
+      continue;
+    }
+    int ok = (el->seq == seq) && (el->check == ~seq);
+    for (unsigned int i = 0; i < 6; i++)
+      ok &= (el->payload[i] == seq * (i + 1));
+    if (!ok) {
+      printf("FAIL: element %u received as %u\n", seq, el->seq);
+      rc = 1;
+      break;
+    }
+    pt_queue_drop(&queue);
+    seq++;
+  }
+  pthread_join(producer, NULL);
+  printf("%-8s %10u %12lu\n", "queue", N_ELEMENTS, n_empty);
+  return rc;
+}
+
+static void *event_producer(void *arg) {
+  (void)arg;
+  for (uint32_t i = 1; i <= N_EVENTS; i++) {
+    data = i;
+    pt_event_set(&data_evt);
+    while (!pt_event_take(&ack_evt)) {
+      if (timed_out())
+        return NULL;
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+static int test_event(void) {
+  pthread_t producer;
+  pthread_create(&producer, NULL, event_producer, NULL);
+
+  int rc = 0;
+  unsigned long n_polls = 0;
+  for (uint32_t i = 1; i <= N_EVENTS; i++) {
+    while (!pt_event_take(&data_evt)) {
+      n_polls++;
+      if (timed_out()) {
+        printf("FAIL: event %u was lost\n", i);
+        rc = 1;
+        break;
+      }
+      sched_yield();
+    }
+    if (rc != 0)
+      break;
+    if (data != i) {
+      printf("FAIL: event %u delivered data %u\n", i, data);
+      rc = 1;
+      break;
+    }
+    pt_event_set(&ack_evt);
+  }
+  pthread_join(producer, NULL);
+  printf("%-8s %10u %12lu\n", "event", N_EVENTS, n_polls);
+  return rc;
+}
+
+int main(void) {
+  int rc = 0;
+  deadline = time(NULL) + TIMEOUT_S;
+  printf("%-8s %10s %12s\n", "test", "count", "idle polls");
+  rc |= test_queue();
+  rc |= test_event();
+  return rc;
+}
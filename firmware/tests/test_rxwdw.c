@@ -0,0 +1,64 @@
+/*
+ * Checks RX window selection
+ *
+ * Capacitor voltages below, at and between the entries of the lookup table
+ * and above its last entry are converted to ADC codes like the charge monitor
+ * samples them. Every voltage must select the margin of the highest entry it
+ * reached, and the minimum margin where no full round fits.
+ */
+#include <stdio.h>
+
+#include "charge.h"
+#include "rxwdw.h"
+
+#define MIN_TCKS 16
+
+static const unsigned int margins[] = RXWDW_LUT;
+
+/* Margin the voltage must select, idx is the highest entry it reached */
+static unsigned int expected(int idx) {
+  if ((idx < 0) || (margins[idx] < MIN_TCKS))
+    return MIN_TCKS;
+  return margins[idx];
+}
+
+static int check(double v, int idx) {
+  unsigned int want = expected(idx);
+  unsigned int got = rxwdw_select(V2ADC(v), MIN_TCKS);
+  if (got != want) {
+    printf("FAIL: %.4fV selects %u instead of %u ticks\n", v, got, want);
+    return 1;
+  }
+  return 0;
+}
+
+static int test_edges(void) {
+  int rc = 0;
+  rc |= check(0.0, -1);
+  rc |= check(RXWDW_LUT_V_MIN - RXWDW_LUT_V_STEP / 2, -1);
+  for (int i = 0; i < RXWDW_LUT_LEN; i++)
+    rc |= check(RXWDW_LUT_V_MIN + i * RXWDW_LUT_V_STEP, i);
+  rc |= check(3.6, RXWDW_LUT_LEN - 1);
+  printf("edges %10d %8u\n", RXWDW_LUT_LEN + 3,
+         rxwdw_select(V2ADC(RXWDW_LUT_V_MIN), MIN_TCKS));
+  return rc;
+}
+
+static int test_midrange(void) {
+  int rc = 0;
+  for (int i = 0; i < RXWDW_LUT_LEN; i++)
+    rc |= check(RXWDW_LUT_V_MIN + (i + 0.5) * RXWDW_LUT_V_STEP, i);
+
+  printf("midrange %7d %8u\n", RXWDW_LUT_LEN,
+         rxwdw_select(V2ADC(3.3), MIN_TCKS));
+  return rc;
+}
+
+int main(void) {
+  int rc = 0;
+  /* Number of checked voltages and a selected margin */
+  printf("%-10s %5s %8s\n", "test", "count", "tcks");
+  rc |= test_edges();
+  rc |= test_midrange();
+  return rc;
+}
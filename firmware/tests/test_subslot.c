@@ -0,0 +1,146 @@
+/*
+ * Checks the arithmetic of beacon sub-slots and RX windows
+ *
+ * For the airtime of the discovery PDU in every radio profile and for the
+ * flync periods of 100Hz and 120Hz flicker, acknowledgements must not
+ * overlap the beacon of the next sub-slot, all beacons must go out within the
+ * flync period and every RX window must reach the beacon of the last usable
+ * sub-slot. A late round must pass over sub-slots that leave no room for the
+ * HFCLK lead, and be skipped after the last one.
+ */
+#include <stdio.h>
+
+#include "subslot.h"
+
+#define RTC_FREQUENCY 32768UL
+
+/* Margins of main.c, RX_WDW_TCKS and the longest one of rxwdw_lut.h */
+static const unsigned int margins[] = {22, 130};
+
+typedef struct {
+  const char *name;
+  /* Airtime of a discovery PDU of 9 bytes, see radio_init() */
+  unsigned int airtime_us;
+  unsigned int tifs_us;
+} profile_t;
+
+static const profile_t profiles[] = {
+    {"1M", 32 + 10 * 8, 50},
+    {"2M", 16 + 10 * 4, 50},
+    {"coded-s2", 376 + 12 * 16 + 6, 150},
+    {"coded-s8", 376 + 12 * 64 + 24, 150},
+};
+
+static unsigned int us2tcks(unsigned int us) {
+  return (us * RTC_FREQUENCY + 999999UL) / 1000000UL;
+}
+
+static int check(const profile_t *p, unsigned int period) {
+  /* Phase 1 of flync_phase2rtctcks() */
+  unsigned int start = (period + 2 * period) / 6;
+  unsigned int airtime_tcks = us2tcks(p->airtime_us);
+  unsigned int spacing = subslot_spacing(p->airtime_us, p->tifs_us);
+  unsigned int n = subslot_count(period, start, spacing);
+
+  printf("%-10s %6u %7u %8u\n", p->name, period, spacing, n);
+
+  /* Beacon, turnaround and acknowledgement of a listener fit into a sub-slot
+   * on top of the guard */
+  unsigned long span_us = 2 * p->airtime_us + p->tifs_us;
+  if ((spacing - DISCO_SUBSLOT_GUARD_TCKS) * 1000000UL <
+      span_us * RTC_FREQUENCY) {
+    printf("FAIL: spacing of %u ticks is shorter than %luus\n", spacing,
+           span_us);
+    return 1;
+  }
+  if ((n < 1) || (n > DISCO_SUBSLOTS)) {
+    printf("FAIL: %u sub-slots\n", n);
+    return 1;
+  }
+  /* Last beacon and its acknowledgements end within the period, one more
+   * sub-slot would not */
+  unsigned int last = subslot_beacon(start, n - 1, spacing);
+  if ((n > 1) && (last + spacing > period)) {
+    printf("FAIL: sub-slot %u ends at %u after the period\n", n - 1,
+           last + spacing);
+    return 1;
+  }
+  if ((n < DISCO_SUBSLOTS) &&
+      (subslot_beacon(start, n, spacing) + spacing <= period)) {
+    printf("FAIL: sub-slot %u would fit\n", n);
+    return 1;
+  }
+
+  for (unsigned int m = 0; m < sizeof(margins) / sizeof(margins[0]); m++) {
+    for (unsigned int s = 0; s < n; s++) {
+      unsigned int wdw = subslot_window(n, s, spacing, margins[m]);
+      /* Radio listens from the end of the own beacon */
+      unsigned int end = subslot_beacon(start, s, spacing) + airtime_tcks +
+                         wdw + 2 * airtime_tcks;
+      if ((wdw < margins[m]) || (end < last + airtime_tcks)) {
+        printf("FAIL: window of sub-slot %u ends at %u before beacon at %u\n",
+               s, end, last);
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+static int test_late_start(void) {
+  unsigned int spacing = subslot_spacing(56, 50);
+  /* No sub-slot fits if the round starts at the end of the period */
+  if ((subslot_count(327, 320, spacing) != 1) ||
+      (subslot_count(327, 327, spacing) != 1)) {
+    printf("FAIL: late start uses more than one sub-slot\n");
+    return 1;
+  }
+  /* A single sub-slot listens for the margin only */
+  if (subslot_window(1, 0, spacing, 22) != 22) {
+    printf("FAIL: single sub-slot extends the window\n");
+    return 1;
+  }
+  printf("%-10s %6u %7u %8u\n", "late", 327, spacing, 1);
+  return 0;
+}
+
+static int test_lead(void) {
+  unsigned int spacing = subslot_spacing(56, 50);
+  unsigned int start = 109, lead = 18;
+  unsigned int n = subslot_count(327, start, spacing);
+  unsigned int beacon = subslot_beacon(start, 1, spacing);
+
+  /* Sub-slot keeps its beacon while the lead fits with a tick to spare */
+  if (subslot_reachable(beacon - lead - 2, lead, start, 1, n, spacing) != 1) {
+    printf("FAIL: sub-slot 1 moved although the lead fits\n");
+    return 1;
+  }
+  /* One tick later, the beacon moves to the next sub-slot */
+  if (subslot_reachable(beacon - lead - 1, lead, start, 1, n, spacing) != 2) {
+    printf("FAIL: sub-slot 1 kept without room for the lead\n");
+    return 1;
+  }
+  /* Round is skipped once the last sub-slot leaves no room */
+  unsigned int last = subslot_beacon(start, n - 1, spacing);
+  if ((subslot_reachable(last - lead - 2, lead, start, 0, n, spacing) !=
+       n - 1) ||
+      (subslot_reachable(last - lead - 1, lead, start, 0, n, spacing) != n) ||
+      (subslot_reachable(326, lead, start, 0, n, spacing) != n)) {
+    printf("FAIL: late round not skipped after the last sub-slot\n");
+    return 1;
+  }
+  printf("%-10s %6u %7u %8u\n", "lead", 327, spacing, n);
+  return 0;
+}
+
+int main(void) {
+  int rc = 0;
+  printf("%-10s %6s %7s %8s\n", "profile", "period", "spacing", "subslots");
+  for (unsigned int i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+    rc |= check(&profiles[i], 327);
+    rc |= check(&profiles[i], 273);
+  }
+  rc |= test_late_start();
+  rc |= test_lead();
+  return rc;
+}
@@ -0,0 +1,179 @@
+/*
+ * Checks the software timer queue
+ *
+ * Random sequences of insertions, cancellations and expirations are compared
+ * against a linear scan of all pending timers. Deadlines are placed around
+ * the wraparound of the 32-bit system time and RTC deadlines beyond the
+ * current flync period are replayed on an RTC that is cleared at the end of
+ * every period, like RTC0 is by the period register.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "timerq.h"
+
+#define N_OPS 200000
+/* Number of simulated flync periods of the RTC replay */
+#define N_PERIODS 20000
+
+static timerq_entry_t entries[TIMERQ_LEN + 2];
+
+static int pending(const timerq_entry_t *e) { return e->idx != TIMERQ_IDLE; }
+
+/* Earliest pending timer by linear scan */
+static timerq_entry_t *reference_min(void) {
+  timerq_entry_t *min = NULL;
+  for (unsigned int i = 0; i < sizeof(entries) / sizeof(entries[0]); i++) {
+    timerq_entry_t *e = &entries[i];
+    if (pending(e) && ((min == NULL) || timerq_before(e->tick, e->rtc,
+                                                      min->tick, min->rtc)))
+      min = e;
+  }
+  return min;
+}
+
+static int test_random(uint32_t base) {
+  timerq_t q;
+  timerq_init(&q);
+  for (unsigned int i = 0; i < sizeof(entries) / sizeof(entries[0]); i++)
+    entries[i].idx = TIMERQ_IDLE;
+
+  uint32_t now = base;
+  unsigned int n_pending = 0, n_fired = 0;
+  int was_pending;
+  for (unsigned int op = 0; op < N_OPS; op++) {
+    timerq_entry_t *e =
+        &entries[rand() % (sizeof(entries) / sizeof(entries[0]))];
+    switch (rand() % 3) {
+    case 0:
+      /* Insert or move a timer, may fail when full */
+      e->tick = now + rand() % 64;
+      e->rtc = rand() % 327;
+      was_pending = pending(e);
+      if (timerq_insert(&q, e) == 0) {
+        n_pending += !was_pending;
+      } else if (was_pending || (n_pending < TIMERQ_LEN)) {
+        printf("FAIL: insert rejected with %u pending\n", n_pending);
+        return 1;
+      }
+      break;
+    case 1:
+      was_pending = pending(e);
+      if (timerq_remove(&q, e) != (was_pending ? 0 : -1)) {
+        printf("FAIL: remove of %s timer\n", was_pending ? "pending" : "idle");
+        return 1;
+      }
+      n_pending -= was_pending;
+      break;
+    case 2:
+      /* Advance time and expire everything up to it in order */
+      now += rand() % 4;
+      uint32_t rtc = rand() % 327;
+      uint32_t prev_tick = 0, prev_rtc = 0;
+      int first = 1;
+      timerq_entry_t *ref;
+      while ((ref = reference_min()) &&
+             !timerq_before(now, rtc, ref->tick, ref->rtc)) {
+        timerq_entry_t *got = timerq_expire(&q, now, rtc);
+        if ((got == NULL) || (got->tick != ref->tick) ||
+            (got->rtc != ref->rtc)) {
+          printf("FAIL: expired timer is not the earliest\n");
+          return 1;
+        }
+        if (!first && timerq_before(got->tick, got->rtc, prev_tick, prev_rtc)) {
+          printf("FAIL: timers expired out of order\n");
+          return 1;
+        }
+        first = 0;
+        prev_tick = got->tick;
+        prev_rtc = got->rtc;
+        n_pending--;
+        n_fired++;
+      }
+      if (timerq_expire(&q, now, rtc) != NULL) {
+        printf("FAIL: timer expired before its deadline\n");
+        return 1;
+      }
+      break;
+    }
+    if (q.n != n_pending) {
+      printf("FAIL: queue has %u timers, expected %u\n", q.n, n_pending);
+      return 1;
+    }
+    /* Timers with equal deadlines may be in any order */
+    timerq_entry_t *head = timerq_peek(&q), *ref = reference_min();
+    if ((head != ref) &&
+        ((head == NULL) || (ref == NULL) || (head->tick != ref->tick) ||
+         (head->rtc != ref->rtc))) {
+      printf("FAIL: queue head is not the earliest timer\n");
+      return 1;
+    }
+  }
+  printf("%-24s %10u %8u %8u\n", "random", base, N_OPS, n_fired);
+  return 0;
+}
+
+/*
+ * Replays RTC timers on a clock that counts RTC ticks and is cleared after
+ * period ticks, which also increments the flync tick. Timers are set by wait
+ * time like timer_rtc_wait and must fire exactly when the absolute RTC time
+ * reaches their deadline.
+ */
+static int test_rtc_clear(uint32_t base, unsigned int period) {
+  timerq_t q;
+  timerq_init(&q);
+  uint64_t deadline[TIMERQ_LEN];
+  timerq_entry_t timers[TIMERQ_LEN];
+  for (unsigned int i = 0; i < TIMERQ_LEN; i++)
+    timers[i].idx = TIMERQ_IDLE;
+
+  uint64_t abs_time = 0;
+  unsigned int n_fired = 0, n_wrapped = 0;
+  uint32_t tick = base;
+  for (unsigned int p = 0; p < N_PERIODS; p++, tick++) {
+    for (uint32_t rtc = 0; rtc < period; rtc++, abs_time++) {
+      timerq_entry_t *e;
+      while ((e = timerq_expire(&q, tick, rtc)) != NULL) {
+        unsigned int i = e - timers;
+        if (deadline[i] != abs_time) {
+          printf("FAIL: timer fired at %llu instead of %llu\n",
+                 (unsigned long long)abs_time, (unsigned long long)deadline[i]);
+          return 1;
+        }
+        n_fired++;
+      }
+
+      /* Occasionally start idle timers with waits up to three periods */
+      unsigned int i = rand() % TIMERQ_LEN;
+      if (pending(&timers[i]) || (rand() % 64 != 0))
+        continue;
+      uint32_t wait = 1 + rand() % (3 * period);
+      timers[i].tick = tick;
+      timers[i].rtc = rtc + wait;
+      n_wrapped += (rtc + wait >= period);
+      timerq_normalize(&timers[i].tick, &timers[i].rtc, period);
+      deadline[i] = abs_time + wait;
+      if (timerq_insert(&q, &timers[i]) != 0) {
+        printf("FAIL: insert rejected\n");
+        return 1;
+      }
+    }
+  }
+  printf("rtc-clear %-14u %10u %8u %8u\n", period, base, n_wrapped, n_fired);
+  return 0;
+}
+
+int main(void) {
+  srand(1);
+  int rc = 0;
+  /* Number of operations or of timers carried over the RTC clear */
+  printf("%-24s %10s %8s %8s\n", "test", "base", "count", "fired");
+  rc |= test_random(1);
+  /* System time wraps around during the test */
+  rc |= test_random(UINT32_MAX - 1000);
+  rc |= test_rtc_clear(1, 327);
+  rc |= test_rtc_clear(UINT32_MAX - N_PERIODS / 2, 327);
+  rc |= test_rtc_clear(UINT32_MAX - N_PERIODS / 2, 273);
+  return rc;
+}
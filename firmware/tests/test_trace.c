@@ -0,0 +1,129 @@
+/*
+ * Checks the trace ring and the trace points of the PLL on the virtual clock
+ *
+ * The ring must keep the most recent records in order across wraparound and
+ * across re-initialization, like after a brownout. Replaying a flicker
+ * signal through the PLL simulation must record paired trace points of every
+ * PLL update, timestamped with the simulated edge. If a path is given, the
+ * ring is written there for trace_decode.py.
+ */
+#include <stdint.h>
+#include <stdio.h>
+
+#include "pll_sim.h"
+#include "trace.h"
+
+/* Edges of the replayed flicker signal */
+#define N_EDGES 2000
+
+#define REC_ID(r) ((r)->id_rtc >> 24)
+#define REC_RTC(r) ((r)->id_rtc & 0xFFFFFF)
+
+static const trace_rec_t *rec_at(const trace_buf_t *buf, uint32_t i) {
+  return &buf->rec[i & (TRACE_BUF_LEN - 1)];
+}
+
+static int test_ring(void) {
+  const trace_buf_t *buf = trace_get();
+  trace_init();
+  uint32_t w0 = buf->w;
+  if ((buf->magic != TRACE_MAGIC) ||
+      (REC_ID(rec_at(buf, w0 - 1)) != TRACE_BOOT)) {
+    printf("FAIL: no boot record after init\n");
+    return 1;
+  }
+
+  /* Overwrite the ring several times, clock encodes the sequence number */
+  unsigned int n = 3 * TRACE_BUF_LEN + 17;
+  for (unsigned int i = 0; i < n; i++) {
+    trace_host_clock(i, i);
+    trace_begin(TRACE_HANDLE_PKT);
+  }
+  if (buf->w - w0 != n) {
+    printf("FAIL: %u records written, expected %u\n", buf->w - w0, n);
+    return 1;
+  }
+  for (uint32_t i = buf->w - TRACE_BUF_LEN; i != buf->w; i++) {
+    const trace_rec_t *r = rec_at(buf, i);
+    if ((r->cycles != i - w0) || (REC_RTC(r) != ((i - w0) & 0xFFFFFF)) ||
+        (REC_ID(r) != TRACE_HANDLE_PKT)) {
+      printf("FAIL: record %u holds %u\n", i - w0, r->cycles);
+      return 1;
+    }
+  }
+
+  /* Records survive a reset as long as the ring is valid */
+  uint32_t w1 = buf->w;
+  trace_init();
+  if ((buf->w != w1 + 1) || (rec_at(buf, w1 - 1)->cycles != n - 1)) {
+    printf("FAIL: records lost across reset\n");
+    return 1;
+  }
+  printf("%-8s %10u %10u\n", "ring", n, TRACE_BUF_LEN);
+  return 0;
+}
+
+static int test_pll(void) {
+  const trace_buf_t *buf = trace_get();
+  pll_sim_t sim;
+  pll_sim_init(&sim, 100, SIM_CLOCK_RTCTICKS, 0, 1, 0);
+  /* Recorded for trace_decode.py like flync_init does */
+  trace_period(SIM_CLOCK_RTCTICKS);
+
+  /* Records of every edge are checked before the ring wraps */
+  unsigned int n_updates = 0;
+  uint32_t w = buf->w;
+  for (long k = 1; k < N_EDGES; k++) {
+    long edge = 100 + k * SIM_CLOCK_RTCTICKS;
+    pll_sim_edge(&sim, edge);
+    for (; w != buf->w; w++) {
+      const trace_rec_t *r = rec_at(buf, w);
+      if (REC_ID(r) == TRACE_PLL_UPDATE) {
+        n_updates++;
+        /* Trace point sees the RTC counter at the edge */
+        if (REC_RTC(r) != edge - sim.boundary) {
+          printf("FAIL: update at RTC %u, edge at phase %ld\n", REC_RTC(r),
+                 edge - sim.boundary);
+          return 1;
+        }
+        if (r->cycles != (uint32_t)(edge * SIM_CYCLES_PER_RTCTICK)) {
+          printf("FAIL: update at cycle %u, edge at %ld\n", r->cycles, edge);
+          return 1;
+        }
+      } else if (REC_ID(r) != (TRACE_PLL_UPDATE | TRACE_END)) {
+        printf("FAIL: unexpected trace point %u\n", REC_ID(r));
+        return 1;
+      }
+    }
+    /* Every update is closed before the handler returns */
+    if (REC_ID(rec_at(buf, buf->w - 1)) != (TRACE_PLL_UPDATE | TRACE_END)) {
+      printf("FAIL: PLL update of edge %ld not closed\n", k);
+      return 1;
+    }
+  }
+  if (n_updates != N_EDGES - 1) {
+    printf("FAIL: %u PLL updates traced, expected %u\n", n_updates,
+           N_EDGES - 1);
+    return 1;
+  }
+  printf("%-8s %10u %10u\n", "pll", N_EDGES - 1, n_updates);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int rc = 0;
+  printf("%-8s %10s %10s\n", "test", "count", "records");
+  rc |= test_ring();
+  rc |= test_pll();
+
+  if (argc > 1) {
+    FILE *f = fopen(argv[1], "wb");
+    if ((f == NULL) || (fwrite(trace_get(), sizeof(trace_buf_t), 1, f) != 1)) {
+      printf("FAIL: cannot write %s\n", argv[1]);
+      rc = 1;
+    }
+    if (f != NULL)
+      fclose(f);
+  }
+  return rc;
+}
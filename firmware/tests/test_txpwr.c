@@ -0,0 +1,125 @@
+/*
+ * Checks TX power control
+ *
+ * Neighbors are placed at random path losses. The selected power must reach
+ * all recently heard neighbors with the target RSSI at the lowest level,
+ * forget neighbors that weren't heard for TXPWR_HORIZON cycles and step up
+ * while no packet is received.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "neighbor.h"
+#include "txpwr.h"
+
+#define N_TRIALS 1000
+
+static const int levels[] = TXPWR_LEVELS;
+#define N_LEVELS (sizeof(levels) / sizeof(levels[0]))
+
+/* Hears a neighbor at the given path loss, sent with the given power */
+static void hear(uint32_t device_id, int pathloss, int tx_power) {
+  uint8_t rssi = pathloss - tx_power;
+  nbr_entry_t *entry = nbr_update(device_id, rssi, 20);
+  txpwr_update(entry, rssi, tx_power);
+}
+
+static int test_select(void) {
+  unsigned int n_max = 0;
+  for (unsigned int t = 0; t < N_TRIALS; t++) {
+    /* Let all previous neighbors expire */
+    for (unsigned int i = 0; i <= NBR_MAX_AGE; i++)
+      nbr_age();
+
+    int pathloss_max = 0;
+    unsigned int n = 1 + rand() % 8;
+    for (unsigned int i = 0; i < n; i++) {
+      int pathloss = 40 + rand() % 50;
+      hear(0x1000 + t * 16 + i, pathloss, levels[rand() % N_LEVELS]);
+      pathloss_max = (pathloss > pathloss_max) ? pathloss : pathloss_max;
+    }
+    int dbm = txpwr_adapt(n);
+
+    int need = TXPWR_TARGET_RSSI + pathloss_max;
+    if ((dbm < need) && (dbm != levels[N_LEVELS - 1])) {
+      printf("FAIL: %ddBm doesn't reach path loss %ddB\n", dbm, pathloss_max);
+      return 1;
+    }
+    if ((dbm > levels[0]) && (need <= dbm - 4)) {
+      for (unsigned int l = 0; l < N_LEVELS; l++) {
+        if ((levels[l] < dbm) && (levels[l] >= need)) {
+          printf("FAIL: %ddBm instead of %ddBm\n", dbm, levels[l]);
+          return 1;
+        }
+      }
+    }
+    n_max += (dbm == levels[N_LEVELS - 1]);
+  }
+  printf("select %10u %8u\n", N_TRIALS, n_max);
+  return 0;
+}
+
+static int test_horizon(void) {
+  for (unsigned int i = 0; i <= NBR_MAX_AGE; i++)
+    nbr_age();
+  /* A far neighbor forces the highest power until it expires */
+  hear(0x2000, 5 - TXPWR_TARGET_RSSI, 8);
+  hear(0x2001, 40, -20);
+  int far = txpwr_adapt(2);
+  for (unsigned int i = 0; i <= TXPWR_HORIZON; i++) {
+    nbr_age();
+    hear(0x2001, 40, -20);
+  }
+  int near = txpwr_adapt(1);
+  if ((far != levels[N_LEVELS - 1]) || (near != levels[0])) {
+    printf("FAIL: %ddBm with far and %ddBm with near neighbor\n", far, near);
+    return 1;
+  }
+  printf("horizon %9d %8d\n", far, near);
+  return 0;
+}
+
+static int test_stall(void) {
+  /* Raise power while nothing is heard, then decay to the required level */
+  int dbm = txpwr_adapt(1);
+  unsigned int n_cycles = 0;
+  while (dbm < levels[N_LEVELS - 1]) {
+    int prev = dbm;
+    dbm = txpwr_adapt(0);
+    if (dbm < prev) {
+      printf("FAIL: power dropped while stalled\n");
+      return 1;
+    }
+    if (++n_cycles > N_LEVELS * TXPWR_STALL_CYCLES) {
+      printf("FAIL: power not raised while stalled\n");
+      return 1;
+    }
+  }
+  int base = levels[0];
+  for (unsigned int i = 0; i < N_LEVELS; i++)
+    dbm = txpwr_adapt(1);
+  if (dbm != base) {
+    printf("FAIL: power stays at %ddBm after stall\n", dbm);
+    return 1;
+  }
+  printf("stall %11u %8d\n", n_cycles, dbm);
+  return 0;
+}
+
+int main(void) {
+  srand(1);
+  int rc = 0;
+  nbr_init();
+  txpwr_init();
+  if (txpwr_get() != TXPWR_DEFAULT) {
+    printf("FAIL: initial power %ddBm\n", txpwr_get());
+    return 1;
+  }
+  /* Number of trials or cycles, and selected power */
+  printf("%-10s %7s %8s\n", "test", "count", "dbm");
+  rc |= test_select();
+  rc |= test_horizon();
+  rc |= test_stall();
+  return rc;
+}
@@ -0,0 +1,156 @@
+/*
+ * Replays harvested power traces through the turn-on threshold controller
+ *
+ * Traces contain the power harvested by a node in uW, one sample per 0.1s.
+ * Lines starting with '#' are comments. Every trace is replayed with the
+ * fixed V_THR_ON of main.c and with the adaptive threshold. The adaptive one
+ * must charge for a shorter time on average, without more brownouts during
+ * waiting and discovery and with few rounds started below V_THR_ROUND.
+ * Brownouts after the power-fail warning are only reported. A node whose
+ * rounds take more than the turn-on threshold leaves must brown out during
+ * discovery and the adaptive threshold must back off from it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "energy_sim.h"
+#include "trace_load.h"
+#include "vthr.h"
+
+#define TRACE_MAX_SAMPLES 65536
+
+/* At most this many per mille of the cycles may start below V_THR_ROUND */
+#define MAX_SHORT_PERMILLE 50
+
+static double power[TRACE_MAX_SAMPLES];
+
+static void print_result(const char *path, int adaptive,
+                         const energy_sim_result_t *res) {
+  double hours = res->t_total * 327.0 / 32768.0 / 3600.0;
+  printf("%-40s %-8s %7lu %7.1f %8.0f %8.0f %6lu %9lu %7lu\n", path,
+         adaptive ? "adaptive" : "fixed", res->n_cycles,
+         (double)res->t_charge / res->n_cycles, res->n_cycles / hours,
+         res->n_rounds / hours, res->n_short, res->brownouts,
+         res->brownouts_pof);
+}
+
+static int replay(const char *path, size_t n) {
+  energy_sim_params_t params;
+  energy_sim_defaults(&params);
+  energy_sim_result_t fixed, adaptive;
+
+  srand(1);
+  energy_sim_run(&params, power, n, 0, &fixed);
+  print_result(path, 0, &fixed);
+  srand(1);
+  energy_sim_run(&params, power, n, 1, &adaptive);
+  print_result(path, 1, &adaptive);
+
+  if (adaptive.brownouts > fixed.brownouts) {
+    printf("FAIL: %lu brownouts instead of %lu\n", adaptive.brownouts,
+           fixed.brownouts);
+    return 1;
+  }
+  if (adaptive.t_charge * fixed.n_cycles >= fixed.t_charge * adaptive.n_cycles) {
+    printf("FAIL: charging did not get shorter\n");
+    return 1;
+  }
+  if (adaptive.n_short * 1000 > adaptive.n_cycles * MAX_SHORT_PERMILLE) {
+    printf("FAIL: %lu of %lu cycles started short\n", adaptive.n_short,
+           adaptive.n_cycles);
+    return 1;
+  }
+  return 0;
+}
+
+static int test_brownout(void) {
+  /* Steady light that is switched off for a few minutes */
+  size_t n = 10 * 60 * 10;
+  for (size_t i = 0; i < n; i++)
+    power[i] = ((i >= n / 3) && (i < 2 * n / 3)) ? 0.0 : 100e-6;
+
+  energy_sim_params_t params;
+  energy_sim_defaults(&params);
+  energy_sim_result_t fixed, adaptive;
+  srand(1);
+  energy_sim_run(&params, power, n, 0, &fixed);
+  if ((fixed.brownouts != 0) || (fixed.brownouts_pof == 0)) {
+    printf("FAIL: %lu brownouts and %lu after warning in the dark\n",
+           fixed.brownouts, fixed.brownouts_pof);
+    return 1;
+  }
+
+  /* A round takes what the capacitor holds between 3.4V and the undervoltage
+   * cutoff, which V_THR_ON only covers if waiting charged enough */
+  params.e_round = 0.5 * params.capacitance * (3.4 * 3.4 - params.v_uv * params.v_uv);
+  srand(1);
+  energy_sim_run(&params, power, n, 0, &fixed);
+  print_result("brownout", 0, &fixed);
+  srand(1);
+  energy_sim_run(&params, power, n, 1, &adaptive);
+  print_result("brownout", 1, &adaptive);
+  if ((fixed.brownouts == 0) || (adaptive.brownouts >= fixed.brownouts)) {
+    printf("FAIL: %lu brownouts instead of fewer than %lu\n",
+           adaptive.brownouts, fixed.brownouts);
+    return 1;
+  }
+  return 0;
+}
+
+static int test_backoff(void) {
+  /* Thresholds of main.c in binary ADC code */
+  vthr_init(938, 853, 995);
+  vthr_backoff(0);
+  unsigned int v_on = 0;
+  for (unsigned int i = 0; i < 100; i++)
+    v_on = vthr_adapt(900);
+  if (v_on != 853) {
+    printf("FAIL: threshold settled at %u\n", v_on);
+    return 1;
+  }
+  /* Waiting drained the capacitor below the required voltage */
+  if ((v_on = vthr_adapt(840)) != 853 + 13) {
+    printf("FAIL: shortfall raised threshold to %u\n", v_on);
+    return 1;
+  }
+  if ((v_on = vthr_backoff(1)) != 853 + 13 + VTHR_BACKOFF) {
+    printf("FAIL: brownout raised threshold to %u\n", v_on);
+    return 1;
+  }
+  /* Boot without another brownout */
+  if ((v_on = vthr_backoff(1)) != 853 + 13 + VTHR_BACKOFF) {
+    printf("FAIL: boot raised threshold to %u\n", v_on);
+    return 1;
+  }
+  for (unsigned int i = 0; i < 100; i++)
+    v_on = vthr_backoff(2 + i);
+  if (v_on != 995) {
+    printf("FAIL: threshold exceeded maximum %u\n", v_on);
+    return 1;
+  }
+  printf("%-40s %-8s %7s %7s %8s %8s %6s %9u %7s\n", "backoff", "-", "-", "-",
+         "-", "-", "-", 100, "-");
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int rc = 0;
+  printf("%-40s %-8s %7s %7s %8s %8s %6s %9s %7s\n", "trace", "thr_on",
+         "cycles", "t_chr", "cycles/h", "rounds/h", "short", "brownouts",
+         "pof_bo");
+  for (int i = 1; i < argc; i++) {
+    size_t n = trace_load(argv[i], power, TRACE_MAX_SAMPLES);
+    /* Samples are given in uW */
+    for (size_t j = 0; j < n; j++)
+      power[j] *= 1e-6;
+    if (n < 2) {
+      printf("FAIL: %s too short\n", argv[i]);
+      rc = 1;
+      continue;
+    }
+    rc |= replay(argv[i], n);
+  }
+  rc |= test_brownout();
+  rc |= test_backoff();
+  return rc;
+}
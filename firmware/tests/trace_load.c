@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "trace_load.h"
+
+size_t trace_load(const char *path, double *values, size_t max) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    perror(path);
+    return 0;
+  }
+
+  char line[256];
+  size_t n = 0;
+  while ((n < max) && fgets(line, sizeof(line), f)) {
+    if ((line[0] == '#') || (line[0] == '\n'))
+      continue;
+    values[n++] = strtod(line, NULL);
+  }
+  fclose(f);
+  return n;
+}
@@ -0,0 +1,20 @@
+#ifndef __TRACE_LOAD_H_
+#define __TRACE_LOAD_H_
+
+#include <stddef.h>
+
+/**
+ * Loads a trace replayed by the host tests
+ *
+ * Traces hold one value per line. Lines starting with '#' are comments and
+ * are skipped like empty lines.
+ *
+ * @param path Trace file
+ * @param values Values read from the trace
+ * @param max Maximum number of values
+ *
+ * @returns Number of values read, 0 if the trace cannot be opened
+ */
+size_t trace_load(const char *path, double *values, size_t max);
+
+#endif /* __TRACE_LOAD_H_ */
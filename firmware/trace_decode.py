@@ -0,0 +1,140 @@
+import struct
+import click
+import numpy as np
+from pathlib import Path
+
+# Ring layout, must match trace_buf_t and TRACE_* definitions in include/trace.h
+TRACE_MAGIC = 0x54524332
+TRACE_END = 0x80
+TRACE_BOOT = 0
+# Magic, write index and flync period precede the records
+HEADER_LEN = 12
+
+# Names of phases by ID, must match enum TracePhase in include/trace.h
+PHASES = {
+    1: "beacon_prep",
+    2: "turnaround",
+    3: "handle_pkt",
+    4: "edge_irq",
+    5: "itf_sample",
+    6: "pll_update",
+}
+
+RTC_FREQUENCY = 32768
+
+
+def load_records(data):
+    """Returns flync period and records of a trace ring dump
+
+    The period is in RTC ticks, 0 if the node didn't record it. Records are
+    ordered from oldest to newest, each a tuple of (id, cycles, rtc).
+    """
+    if len(data) < HEADER_LEN:
+        raise click.ClickException("Dump too short")
+    magic, w, rtc_period = struct.unpack_from("<III", data, 0)
+    if magic != TRACE_MAGIC:
+        raise click.ClickException("No valid trace ring in dump")
+
+    n_recs = (len(data) - HEADER_LEN) // 8
+    if n_recs == 0 or n_recs & (n_recs - 1):
+        raise click.ClickException(f"Ring length {n_recs} is no power of two")
+
+    records = list()
+    for i in range(max(0, w - n_recs), w):
+        cycles, id_rtc = struct.unpack_from(
+            "<II", data, HEADER_LEN + 8 * (i % n_recs)
+        )
+        records.append((id_rtc >> 24, cycles, id_rtc & 0xFFFFFF))
+    return rtc_period, records
+
+
+def latencies(records, cpu_freq, rtc_period):
+    """Pairs begin and end of every phase and returns latencies in us per phase
+
+    The cycle counter stops while the CPU sleeps, so phases that include sleep
+    are measured with the RTC instead. The RTC is cleared at the end of every
+    flync period, which is corrected for phases shorter than a period.
+    """
+    lat = {name: list() for name in PHASES.values()}
+    open_phases = dict()
+    for rec_id, cycles, rtc in records:
+        if rec_id == TRACE_BOOT:
+            # Cycle counter restarted, phases interrupted by the reset are lost
+            open_phases.clear()
+            continue
+        phase = rec_id & ~TRACE_END
+        if phase not in PHASES:
+            continue
+        if not rec_id & TRACE_END:
+            open_phases[phase] = (cycles, rtc)
+            continue
+        if phase not in open_phases:
+            continue
+        begin_cycles, begin_rtc = open_phases.pop(phase)
+
+        t_cycles = ((cycles - begin_cycles) & 0xFFFFFFFF) / cpu_freq
+        t_rtc = ((rtc - begin_rtc) % rtc_period) / RTC_FREQUENCY
+        # Cycle count is accurate to the cycle, unless the CPU was sleeping
+        t = t_rtc if t_rtc > t_cycles + 2 / RTC_FREQUENCY else t_cycles
+        lat[PHASES[phase]].append(t * 1e6)
+    return lat
+
+
+def print_histogram(name, values, n_bins, width=40):
+    values = np.array(values)
+    click.echo(
+        f"{name}: n={len(values)} min={values.min():.2f}us "
+        f"median={np.median(values):.2f}us p99={np.percentile(values, 99):.2f}us "
+        f"max={values.max():.2f}us"
+    )
+    # All samples in one bin when there is no spread, e.g. on the host
+    counts, edges = np.histogram(
+        values, bins=n_bins if values.max() > values.min() else 1
+    )
+    for count, low, high in zip(counts, edges[:-1], edges[1:]):
+        bar = "#" * int(np.ceil(width * count / counts.max()))
+        click.echo(f"  {low:10.2f} - {high:10.2f}us {count:8d} {bar}")
+
+
+@click.command(short_help="Prints latency histograms of traced phases")
+@click.option(
+    "--input-path",
+    "-i",
+    type=click.Path(exists=True, dir_okay=False),
+    required=True,
+    help="Binary dump of trace_buf, e.g. read from the node with a debugger",
+)
+@click.option(
+    "--cpu-freq",
+    type=float,
+    default=64e6,
+    show_default=True,
+    help="Frequency of the cycle counter in Hz",
+)
+@click.option(
+    "--rtc-period",
+    type=int,
+    help="Flync period in RTC ticks, overrides the period recorded by the node",
+)
+@click.option(
+    "--bins", "-b", type=int, default=10, show_default=True, help="Histogram bins"
+)
+def cli(input_path, cpu_freq, rtc_period, bins):
+
+    recorded_period, records = load_records(Path(input_path).read_bytes())
+    if rtc_period is None:
+        if recorded_period == 0:
+            raise click.ClickException(
+                "Dump holds no flync period, provide --rtc-period"
+            )
+        rtc_period = recorded_period
+    n_boots = sum(1 for rec in records if rec[0] == TRACE_BOOT)
+    click.echo(f"{len(records)} records, {n_boots} boots")
+
+    for name, values in latencies(records, cpu_freq, rtc_period).items():
+        if values:
+            print_histogram(name, values, bins)
+
+
+if __name__ == "__main__":
+    cli()
@@ -0,0 +1,29 @@
+import numpy as np
+import matplotlib.pyplot as plt
+
+from neslab.find import Model
+from neslab.find.sim import Simulation
+
+# Charging time of 25 slots
+t_chr = 25
+# Geometric distribution with scale 0.3
+scale = 0.3
+
+n_nodes = [8, 16, 24, 32, 40, 48]
+
+for n_channels in [1, 2, 3]:
+    lat_model = np.empty((len(n_nodes),))
+    lat_sim = np.empty((len(n_nodes),))
+    for i, n in enumerate(n_nodes):
+        m = Model(scale, "Geometric", t_chr, n_nodes=n, n_slots=20000, n_channels=n_channels)
+        lat_model[i] = m.disco_latency()
+        s = Simulation(scale, "Geometric", t_chr, n_nodes=n, n_channels=n_channels)
+        lat_sim[i] = s.disco_latency(20000, n_runs=20)
+
+    lines = plt.plot(n_nodes, lat_model, label=f"{n_channels} channels")
+    plt.plot(n_nodes, lat_sim, "x", color=lines[0].get_color())
+
+plt.xlabel("Number of nodes")
+plt.ylabel("Discovery Latency [slots]")
+plt.legend()
+plt.show()
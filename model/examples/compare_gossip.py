@@ -0,0 +1,44 @@
+import numpy as np
+import matplotlib.pyplot as plt
+
+from neslab.find.sim import Simulation, grid_adjacency, airtime_us
+
+# Charging time of 25 slots without gossip
+t_chr = 25
+# Geometric distribution with scale 0.3
+scale = 0.3
+# Share of the energy of a charging cycle spent on the radio without gossip
+radio_frac = 0.5
+# RX window margin in us, beacon and acknowledgement add their airtime
+rx_margin_us = 22 * 1e6 / 32768
+
+# Two rows of rooms, nodes hear the adjacent rooms and the diagonal ones
+adjacency = grid_adjacency(8, 2, radius=1.5)
+
+n_slots = 20000
+
+
+def radio_us(n_gossip):
+    """Radio on time of a discovery round, i.e. beacon and RX window"""
+    return 3 * airtime_us(n_gossip) + rx_margin_us
+
+
+for n_gossip in [0, 1, 2, 4, 8]:
+    # Longer packets take longer to charge for
+    energy = 1 - radio_frac + radio_frac * radio_us(n_gossip) / radio_us(0)
+    t_chr_gossip = int(np.round(t_chr * energy))
+
+    s = Simulation(scale, "Geometric", t_chr_gossip, adjacency=adjacency)
+    frac = s.topo_frac(n_slots, n_gossip, n_runs=20)
+    t_90 = np.argmax(frac >= 0.9) if frac[-1] >= 0.9 else np.nan
+    print(
+        f"{n_gossip} gossiped neighbors: airtime {airtime_us(n_gossip)}us "
+        f"t_chr {t_chr_gossip} 90% of two-hop topology after {t_90} slots, "
+        f"{100 * frac[-1]:.1f}% after {n_slots} slots"
+    )
+    plt.plot(frac, label=f"{n_gossip} gossiped neighbors")
+
+plt.xlabel("Time [slots]")
+plt.ylabel("Known two-hop topology")
+plt.legend()
+plt.show()
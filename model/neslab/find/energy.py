@@ -0,0 +1,116 @@
+import numpy as np
+from scipy.stats import norm
+
+# Defaults describe the FLYNC node (../hardware) with the 2Mbit radio profile
+RTC_FREQUENCY = 32768
+# Energy storage in F
+CAPACITANCE = 47e-6
+# Power of the radio in RX in W, 6.4mA at 3V
+P_RX = 19.2e-3
+# Energy of a round apart from the RX window in J, i.e. HFCLK startup, beacon,
+# trailing beacon and CPU
+E_FIXED = 5.3e-6
+# Airtime of a packet in RTC ticks, the window adds two of them to its margin
+AIRTIME_TCKS = 2
+# Flync period in RTC ticks
+PERIOD_TCKS = 327
+
+
+def cap_energy(v: float, v_min: float, capacitance: float = CAPACITANCE):
+    """Energy stored in the capacitor above a minimum voltage
+
+    Args:
+        v (float): Capacitor voltage in V
+        v_min (float): Voltage down to which energy can be spent in V
+        capacitance (float): Capacitance in F
+
+    Returns:
+        float: Energy in J
+    """
+    return max(0.0, 0.5 * capacitance * (v ** 2 - v_min ** 2))
+
+
+def round_energy(margin_tcks: int, e_fixed: float = E_FIXED, p_rx: float = P_RX):
+    """Energy of a discovery round with given RX window margin
+
+    Args:
+        margin_tcks (int): Margin of the RX window in RTC ticks, as passed to
+            disco_thread in the firmware
+        e_fixed (float): Energy of a round apart from the RX window in J
+        p_rx (float): Power of the radio in RX in W
+
+    Returns:
+        float: Energy in J
+    """
+    wdw_tcks = margin_tcks + 2 * AIRTIME_TCKS
+    return e_fixed + p_rx * wdw_tcks / RTC_FREQUENCY
+
+
+def p_hear(margin_tcks: int, sigma: float = 4.0, p_sync: float = 0.8):
+    """Probability to hear a neighbor that is active in the same slot
+
+    A node hears the heading beacon of a neighbor that starts its round at
+    least one airtime and at most the window length later. Otherwise, the
+    beacons overlap or the neighbor's beacon misses the window. The offset of
+    neighbors that are synchronized by the same lamp is normally distributed,
+    see the phase error reported by bench_wakeups in the firmware. The offset
+    of other neighbors, e.g. under a different lamp, is uniform over the slot.
+
+    Args:
+        margin_tcks (int): Margin of the RX window in RTC ticks
+        sigma (float): Standard deviation of the offset of synchronized
+            neighbors in RTC ticks
+        p_sync (float): Fraction of synchronized neighbors
+
+    Returns:
+        float: Probability that either node hears the other
+    """
+    wdw_tcks = margin_tcks + 2 * AIRTIME_TCKS
+    guard = AIRTIME_TCKS
+    # Offset in either direction lets one of both nodes hear the other
+    p_synced = 2 * (norm.cdf(wdw_tcks, scale=sigma) - norm.cdf(guard, scale=sigma))
+    p_unsynced = min(1.0, 2 * (wdw_tcks - guard) / PERIOD_TCKS)
+    return p_sync * p_synced + (1 - p_sync) * p_unsynced
+
+
+def optimal_margins(
+    energies: np.ndarray,
+    margins: np.ndarray = np.arange(2, 131, 2),
+    resolution: float = 0.1e-6,
+    **kwargs,
+):
+    """RX window margins that maximize expected rendezvous for stored energy
+
+    Nodes spend the energy on consecutive rounds. For every amount of energy,
+    a dynamic program picks the margin of the next round that maximizes the
+    expected number of neighbors heard in this and all following rounds, i.e.
+    rendezvous per joule of the energy that would otherwise be wasted.
+
+    Args:
+        energies (np.ndarray): Available energies in J
+        margins (np.ndarray): Candidate margins in RTC ticks
+        resolution (float): Energy resolution of the dynamic program in J
+        kwargs: Passed to p_hear
+
+    Returns:
+        tuple: Margin of the first round, 0 if no round fits, and expected
+        number of neighbors heard per neighbor in the slot, for every energy
+    """
+    energies = np.atleast_1d(energies)
+    cost = np.array([int(np.ceil(round_energy(m) / resolution)) for m in margins])
+    gain = np.array([p_hear(m, **kwargs) for m in margins])
+
+    n_steps = int(np.ceil(np.max(energies) / resolution)) + 1
+    value = np.zeros((n_steps,))
+    choice = np.zeros((n_steps,), dtype=int)
+    for e in range(n_steps):
+        fits = cost <= e
+        if not np.any(fits):
+            continue
+        candidates = gain[fits] + value[e - cost[fits]]
+        best = np.argmax(candidates)
+        value[e] = candidates[best]
+        choice[e] = margins[fits][best]
+
+    idx = np.floor(energies / resolution).astype(int)
+    return choice[idx], value[idx]
@@ -33,14 +33,31 @@ def expected_value(pmf: np.array):
     return np.sum(pmf * np.arange(len(pmf)))
 
 
-def act2rend(activities: np.ndarray):
+def act2rend(activities: np.ndarray, n_channels: int = 1, n_subslots: int = 1):
     """Calculates probability of rendezvous for given probability of acitivities
 
     Takes the probability of activity of all nodes in a clique and calculates the
-    probability of a successful rendezvous for each link at each slot.
+    probability of a successful rendezvous for each link at each slot. With more
+    than one channel, every active node is on any of the channels with equal
+    probability, independent of the other nodes, like nodes hopping on
+    independent sequences. The two nodes of a link then meet on the same channel
+    with probability 1/n_channels, but other nodes only collide with them with
+    that probability, too.
+
+    With more than one beacon sub-slot, every active node beacons in any of the
+    sub-slots of the slot with equal probability and listens to all later ones.
+    Beacons in different sub-slots don't overlap, so another node only collides
+    with the link if it picks the sub-slot of either of its nodes. Both nodes of
+    the link may pick the same sub-slot, like all nodes with a single one.
+    This overestimates rendezvous with more than two active nodes: a node only
+    hears the ones in earlier sub-slots by their trailing beacons, and earlier
+    nodes whose RX window extends to the last sub-slot send them at the same
+    moment, so they collide.
 
     Args:
         activities (np.ndarray): Shape (n, m) array with n slots and m nodes
+        n_channels (int): Number of channels
+        n_subslots (int): Number of beacon sub-slots per slot
 
     Returns:
         np.ndarray: Shape (n, l) array with probability for rendezvous in n slots and l links
@@ -50,10 +67,14 @@ def act2rend(activities: np.ndarray):
     p_rendz = np.empty((activities.shape[0], len(links)))
     for i, link in enumerate(links):
         others = list(set(node_ids) - set(link))
-        # probability that the two 'link' nodes are active at the same time
-        p_sim_on = np.product(activities[:, link], axis=1)
-        # probability that none of the other nodes is active
-        p_no_coll = np.product(1.0 - activities[:, others], axis=1)
+        # probability that the two 'link' nodes are active on the same channel
+        p_sim_on = np.product(activities[:, link], axis=1) / n_channels
+        # probability that none of the other nodes is active on that channel
+        # in the sub-slots of the link, i.e. one or two of them
+        p_other = activities[:, others] / n_channels / n_subslots
+        p_no_coll_same = np.product(1.0 - p_other, axis=1)
+        p_no_coll_diff = np.product(1.0 - 2 * p_other, axis=1)
+        p_no_coll = (p_no_coll_same + (n_subslots - 1) * p_no_coll_diff) / n_subslots
         p_rendz[:, i] = p_sim_on * p_no_coll
     return p_rendz
 
@@ -100,6 +121,8 @@ class Model(object):
         offset: Union[int, Iterable] = None,
         n_slots: int = 100000,
         n_jobs: int = None,
+        n_channels: int = 1,
+        n_subslots: int = 1,
     ):
         if n_nodes is None:
             if isinstance(t_chr, Iterable):
@@ -110,6 +133,8 @@ class Model(object):
             self.n_nodes = n_nodes
 
         self.n_slots = n_slots
+        self.n_channels = n_channels
+        self.n_subslots = n_subslots
         if n_jobs is None:
             self.n_jobs = multiprocessing.cpu_count()
         else:
@@ -200,18 +225,22 @@ class Model(object):
             np.ndarray: Shape (n, l) array with cdf for rendezvous in n slots and l links
         """
         if self.n_jobs == 1:
-            p_rendz = act2rend(self._activities)
+            p_rendz = act2rend(self._activities, self.n_channels, self.n_subslots)
         else:
             partition_size = self.n_slots // self.n_jobs
             args = list()
             for i in range(self.n_jobs - 1):
                 idx_start = i * partition_size
                 idx_end = (i + 1) * partition_size
-                args.append((self._activities[idx_start:idx_end],))
+                args.append(
+                    (self._activities[idx_start:idx_end], self.n_channels, self.n_subslots)
+                )
 
             idx_start = (self.n_jobs - 1) * partition_size
             idx_end = self.n_slots
-            args.append((self._activities[idx_start:idx_end],))
+            args.append(
+                (self._activities[idx_start:idx_end], self.n_channels, self.n_subslots)
+            )
             with multiprocessing.Pool(self.n_jobs) as p:
                 logger.debug(f"Calculating rendezvous with {self.n_jobs} jobs")
                 results = p.starmap(act2rend, args)
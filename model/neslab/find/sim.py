@@ -0,0 +1,354 @@
+import numpy as np
+from typing import Union
+from typing import Iterable
+from itertools import combinations
+
+from . import distributions as dists
+
+# Hop sequences repeat after this many slots, like the 16-bit slot counter
+# advertised by the firmware
+HOP_PERIOD = 1 << 16
+
+
+def grid_adjacency(n_x: int, n_y: int = 1, radius: float = 1.0):
+    """Nodes on a grid that hear each other within a radius
+
+    Models a multi-hop deployment, e.g. nodes along the rooms of a building.
+
+    Args:
+        n_x (int): Number of nodes along the grid's first axis
+        n_y (int): Number of nodes along the grid's second axis
+        radius (float): Radio range in grid spacings
+
+    Returns:
+        np.ndarray: Shape (n_x * n_y, n_x * n_y) boolean adjacency matrix
+    """
+    xy = np.array([(x, y) for y in range(n_y) for x in range(n_x)])
+    dist = np.linalg.norm(xy[:, None, :] - xy[None, :, :], axis=2)
+    return (dist <= radius) & (dist > 0)
+
+
+def airtime_us(n_gossip: int, byte_us: int = 4, head_us: int = 16):
+    """Airtime of a discovery packet like radio_airtime_us in the firmware
+
+    Defaults to the 2Mbit radio profile. The PDU has ten bytes plus two bytes
+    per gossiped neighbor and one byte of CRC.
+
+    Args:
+        n_gossip (int): Number of gossiped neighbors
+        byte_us (int): Airtime of a byte in us
+        head_us (int): Airtime of preamble and address in us
+
+    Returns:
+        int: Airtime in us
+    """
+    return head_us + (10 + 2 * n_gossip + 1) * byte_us
+
+
+def hop_mix(h: np.ndarray):
+    """Scrambles slot counters like hop_mix in the firmware (firmware/src/hop.c)
+
+    Args:
+        h (np.ndarray): Hop slot counters
+
+    Returns:
+        np.ndarray: Scrambled 32-bit values
+    """
+    x = np.asarray(h, dtype=np.uint64) & np.uint64(HOP_PERIOD - 1)
+    mask = np.uint64(0xFFFFFFFF)
+    x ^= x >> np.uint64(16)
+    x = (x * np.uint64(0x7FEB352D)) & mask
+    x ^= x >> np.uint64(15)
+    x = (x * np.uint64(0x846CA68B)) & mask
+    x ^= x >> np.uint64(16)
+    return x
+
+
+def hop_channel(h: np.ndarray, n_channels: int):
+    """Channel index of hop slot counters
+
+    Args:
+        h (np.ndarray): Hop slot counters
+        n_channels (int): Number of channels
+
+    Returns:
+        np.ndarray: Channel indices
+    """
+    return (hop_mix(h) % np.uint64(n_channels)).astype(int)
+
+
+class Simulation(object):
+    """Slot-level Monte Carlo simulation of a clique of FIND nodes
+
+    Every node charges for t_chr slots, waits for a random number of slots drawn
+    from the delay distribution and is active for one slot. Active nodes send a
+    beacon on the channel of their hop sequence and listen on it. A link is
+    discovered in a slot, in which both nodes are active on the same channel and
+    no other node is active on that channel. Other than the analytical model,
+    the simulation uses actual hop sequences and yields samples of discovery
+    latencies.
+
+    With an adjacency matrix, nodes only hear their neighbors and a link is
+    discovered if no other neighbor of either node is active on the channel.
+    The default is a clique.
+
+    With more than one beacon sub-slot, active nodes beacon in a random
+    sub-slot of the slot and other nodes only collide with a link if they pick
+    the sub-slot of either of its nodes on the same channel. Like the model,
+    the simulation ignores that trailing beacons of nodes in earlier sub-slots
+    go out at the same moment and collide at the later nodes.
+    """
+
+    def __init__(
+        self,
+        scale: Union[float, Iterable],
+        dist_name: str,
+        t_chr: Union[int, Iterable],
+        n_nodes: int = None,
+        offset: Union[int, Iterable] = None,
+        n_channels: int = 1,
+        seed: int = None,
+        adjacency: np.ndarray = None,
+        n_subslots: int = 1,
+    ):
+        if n_nodes is None:
+            if adjacency is not None:
+                n_nodes = len(adjacency)
+            else:
+                n_nodes = len(t_chr) if isinstance(t_chr, Iterable) else 2
+        self.n_nodes = n_nodes
+        self.n_channels = n_channels
+        self.n_subslots = n_subslots
+        self._rng = np.random.default_rng(seed)
+
+        if not isinstance(t_chr, Iterable):
+            t_chr = [t_chr for _ in range(n_nodes)]
+        if not isinstance(scale, Iterable):
+            scale = [scale for _ in range(n_nodes)]
+        if len(t_chr) != n_nodes or len(scale) != n_nodes:
+            raise ValueError("Number of t_chrs and scales must match number of nodes")
+        self.t_chr = np.array(t_chr, dtype=int)
+
+        dist_class = getattr(dists, dist_name.lower().capitalize())
+        self._pmfs = list()
+        for s in scale:
+            dist = dist_class(s)
+            pmf = dist.pmf(np.arange(dist.min_support()))
+            self._pmfs.append(pmf / np.sum(pmf))
+
+        if offset is None:
+            # Spread first wakeups evenly, like the analytical model does
+            dist = dist_class(scale[0])
+            distance = t_chr[0] + 2 * dist.expectation()
+            offset = [int(np.round(i * distance / n_nodes)) for i in range(n_nodes)]
+        elif not isinstance(offset, Iterable):
+            offset = [0, offset] if n_nodes == 2 else [0] * n_nodes
+        if len(offset) != n_nodes:
+            raise ValueError("Number of offsets must match number of nodes")
+        self.offset = np.array(offset, dtype=int)
+
+        if adjacency is None:
+            adjacency = ~np.eye(n_nodes, dtype=bool)
+        adjacency = np.asarray(adjacency, dtype=bool)
+        if adjacency.shape != (n_nodes, n_nodes):
+            raise ValueError("Adjacency must be a square matrix of all nodes")
+        if (adjacency != adjacency.T).any():
+            raise ValueError("Adjacency must be symmetric")
+        self.adjacency = adjacency
+
+    def links(self):
+        return [(a, b) for a, b in combinations(range(self.n_nodes), 2) if self.adjacency[a, b]]
+
+    def _activity(self, n_slots: int):
+        """Samples which node is active in which slot
+
+        Returns:
+            np.ndarray: Shape (n_slots, n_nodes) boolean array
+        """
+        act = np.zeros((n_slots, self.n_nodes), dtype=bool)
+        for i in range(self.n_nodes):
+            pmf = self._pmfs[i]
+            # Enough wakeups to cover all slots, even with minimum waits
+            n_wkups = (n_slots + self.offset[i]) // self.t_chr[i] + 1
+            waits = self._rng.choice(len(pmf), size=n_wkups, p=pmf)
+            slots = np.cumsum(waits) + np.arange(n_wkups) * self.t_chr[i]
+            slots = slots - self.offset[i]
+            slots = slots[(slots >= 0) & (slots < n_slots)]
+            act[slots, i] = True
+        return act
+
+    def _channels(self, n_slots: int):
+        """Channel of every node in every slot
+
+        Every node hops on its own sequence, keyed on its slot counter, which
+        starts at a random value.
+
+        Returns:
+            np.ndarray: Shape (n_slots, n_nodes) array of channel indices
+        """
+        if self.n_channels == 1:
+            return np.zeros((n_slots, self.n_nodes), dtype=int)
+        hop_offset = self._rng.integers(0, HOP_PERIOD, size=self.n_nodes)
+        h = np.arange(n_slots)[:, None] + hop_offset[None, :]
+        return hop_channel(h, self.n_channels)
+
+    def _subslots(self, n_slots: int):
+        """Beacon sub-slot of every node in every slot
+
+        Returns:
+            np.ndarray: Shape (n_slots, n_nodes) array of sub-slot indices
+        """
+        if self.n_subslots == 1:
+            return np.zeros((n_slots, self.n_nodes), dtype=int)
+        return self._rng.integers(0, self.n_subslots, size=(n_slots, self.n_nodes))
+
+    def run(self, n_slots: int):
+        """Simulates the clique once
+
+        Args:
+            n_slots (int): Number of simulated slots
+
+        Returns:
+            np.ndarray: Slot in which each link was discovered first, n_slots if
+            it was not discovered
+        """
+        rendz = self._rendezvous(n_slots)
+        t_disco = np.where(np.any(rendz, axis=0), np.argmax(rendz, axis=0), n_slots)
+        return t_disco
+
+    def _rendezvous(self, n_slots: int):
+        """Samples in which slots each link meets without collision
+
+        Returns:
+            np.ndarray: Shape (n_slots, n_links) boolean array
+        """
+        act = self._activity(n_slots)
+        chan = self._channels(n_slots)
+        links = np.array(self.links(), dtype=int).reshape(-1, 2)
+        a, b = links[:, 0], links[:, 1]
+
+        # Nodes that can disturb a link, including both of its ends
+        hood = self.adjacency[a] | self.adjacency[b]
+        hood[np.arange(len(links)), a] = True
+        hood[np.arange(len(links)), b] = True
+
+        # Nodes collide if they beacon on the same channel in the same sub-slot
+        key = chan * self.n_subslots + self._subslots(n_slots)
+        # Number of active nodes in the neighborhood of each link that share the
+        # channel and sub-slot of either node of the link
+        busy_a = np.zeros((n_slots, len(links)), dtype=int)
+        busy_b = np.zeros((n_slots, len(links)), dtype=int)
+        for k in range(self.n_channels * self.n_subslots):
+            busy = (act & (key == k)).astype(int) @ hood.T.astype(int)
+            busy_a += np.where(key[:, a] == k, busy, 0)
+            busy_b += np.where(key[:, b] == k, busy, 0)
+        alone = np.where(
+            key[:, a] == key[:, b], busy_a == 2, (busy_a == 1) & (busy_b == 1)
+        )
+
+        return act[:, a] & act[:, b] & (chan[:, a] == chan[:, b]) & alone
+
+    def run_gossip(self, n_slots: int, n_gossip: int):
+        """Simulates how nodes learn their two-hop topology
+
+        A node knows a link once it took part in its discovery, or once it met
+        one end of the link, which gossiped the other end among its n_gossip
+        most recently met neighbors. Like the firmware, gossip is exchanged in
+        both directions of a rendezvous.
+
+        Args:
+            n_slots (int): Number of simulated slots
+            n_gossip (int): Number of gossiped neighbors, 0 without gossip
+
+        Returns:
+            tuple: Slot from which each node knew all links of its two-hop
+            neighborhood, n_slots if it never did, and fraction of these
+            links known by all nodes in each slot
+        """
+        links = self.links()
+        rendz = self._rendezvous(n_slots)
+        link_idx = {link: i for i, link in enumerate(links)}
+
+        # Links of each node and of its neighbors
+        target = np.zeros((self.n_nodes, len(links)), dtype=bool)
+        for i, (a, b) in enumerate(links):
+            for n in range(self.n_nodes):
+                target[n, i] = n in (a, b) or self.adjacency[n, a] or self.adjacency[n, b]
+        known = np.zeros_like(target)
+        # Slot of the last rendezvous of each node with each neighbor
+        last_met = np.full((self.n_nodes, self.n_nodes), -1)
+
+        t_full = np.full((self.n_nodes,), n_slots)
+        n_known = np.zeros((n_slots,), dtype=int)
+        for slot in np.flatnonzero(np.any(rendz, axis=1)):
+            for i in np.flatnonzero(rendz[slot]):
+                a, b = links[i]
+                # Both sides gossip their neighbors met before this slot
+                gossip = {n: self._recent(last_met[n], n_gossip) for n in (a, b)}
+                for n, peer in ((a, b), (b, a)):
+                    known[n, i] = True
+                    for m in gossip[peer]:
+                        if m != n:
+                            known[n, link_idx[tuple(sorted((peer, m)))]] = True
+                last_met[a, b] = last_met[b, a] = slot
+            n_known[slot] = np.sum(known & target)
+            done = np.all(known >= target, axis=1) & (t_full == n_slots)
+            t_full[done] = slot
+        frac = np.maximum.accumulate(n_known) / np.sum(target)
+        return t_full, frac
+
+    @staticmethod
+    def _recent(last_met: np.ndarray, n_gossip: int):
+        """Up to n_gossip most recently met neighbors, latest first"""
+        met = np.flatnonzero(last_met >= 0)
+        if n_gossip == 0 or len(met) == 0:
+            return []
+        order = np.argsort(-last_met[met], kind="stable")
+        return met[order[:n_gossip]].tolist()
+
+    def topo_latency(self, n_slots: int, n_gossip: int, n_runs: int = 100):
+        """Mean number of slots until a node knows its two-hop topology
+
+        Nodes that don't learn it within n_slots count with n_slots.
+        """
+        t_full = [self.run_gossip(n_slots, n_gossip)[0] for _ in range(n_runs)]
+        return np.mean(t_full)
+
+    def topo_frac(self, n_slots: int, n_gossip: int, n_runs: int = 100):
+        """Fraction of two-hop topology known by all nodes over slots
+
+        Args:
+            n_slots (int): Number of simulated slots per run
+            n_gossip (int): Number of gossiped neighbors, 0 without gossip
+            n_runs (int): Number of runs
+
+        Returns:
+            np.ndarray: Fraction of links known up to each slot, averaged over
+            runs
+        """
+        frac = [self.run_gossip(n_slots, n_gossip)[1] for _ in range(n_runs)]
+        return np.mean(frac, axis=0)
+
+    def disco_frac(self, n_slots: int, n_runs: int = 100):
+        """Fraction of discovered links over slots, averaged over runs
+
+        Args:
+            n_slots (int): Number of simulated slots per run
+            n_runs (int): Number of runs
+
+        Returns:
+            np.ndarray: Fraction of links discovered up to each slot
+        """
+        counts = np.zeros((n_slots + 1,))
+        for _ in range(n_runs):
+            t_disco = self.run(n_slots)
+            counts += np.bincount(t_disco, minlength=n_slots + 1)
+        return np.cumsum(counts)[:-1] / (n_runs * len(self.links()))
+
+    def disco_latency(self, n_slots: int, n_runs: int = 100):
+        """Mean number of slots until a link is discovered
+
+        Links that are not discovered within n_slots count with n_slots.
+        """
+        t_disco = [self.run(n_slots) for _ in range(n_runs)]
+        return np.mean(t_disco)
@@ -76,9 +76,12 @@ def main(
     args_tchrs = list(product(np.arange(5, 2500, 5), [2]))
     # Configs for charging time 25 and different numbers of nodes
     args_nnodes = list(product([25], np.arange(3, 110, 5)))
+    # Configs for the 2-D lookup table over charging time and density used by the
+    # firmware (see firmware/gen_scale_lut.py)
+    args_lut = list(product(np.arange(10, 2570, 10), np.arange(4, 34, 2)))
 
     futures = list()
-    for arg in args_tchrs + args_nnodes:
+    for arg in args_tchrs + args_nnodes + args_lut:
         futures.append(job.remote(arg[0], arg[1]))
 
     logger.info(f"Running {len(futures)} jobs")
@@ -0,0 +1,25 @@
+import numpy as np
+from neslab.find.energy import cap_energy, round_energy, p_hear, optimal_margins
+
+MARGINS = np.arange(22, 131, 2)
+
+
+def test_p_hear():
+    p = np.array([p_hear(m) for m in MARGINS])
+    assert (np.diff(p) >= 0).all()
+    assert p[0] > 0.0 and p[-1] <= 1.0
+
+
+def test_optimal_margins():
+    energies = np.linspace(0, cap_energy(3.5, 3.0), 50)
+    margin, value = optimal_margins(energies, MARGINS)
+    # More energy never hurts
+    assert (np.diff(value) >= 0).all()
+    # No round without the energy for the shortest one
+    fits = energies >= round_energy(MARGINS[0])
+    assert (margin[~fits] == 0).all() and (value[~fits] == 0).all()
+    assert (margin[fits] >= MARGINS[0]).all()
+    # Spending everything on one long window is never better
+    single = np.array([max(p_hear(m) for m in MARGINS if round_energy(m) <= e)
+                       if f else 0.0 for e, f in zip(energies, fits)])
+    assert (value >= single - 1e-9).all()
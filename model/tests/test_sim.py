@@ -0,0 +1,101 @@
+import pytest
+import numpy as np
+from scipy.special import binom
+from neslab.find import Model
+from neslab.find.sim import Simulation, hop_channel, grid_adjacency, HOP_PERIOD
+
+N_SLOTS = 2000
+
+
+@pytest.fixture
+def sim():
+    return Simulation(0.3, "Geometric", 25, n_nodes=4, seed=1)
+
+
+def test_run(sim):
+    t_disco = sim.run(N_SLOTS)
+    assert len(t_disco) == binom(sim.n_nodes, 2)
+    assert ((t_disco >= 0) & (t_disco <= N_SLOTS)).all()
+
+
+def test_disco_frac(sim):
+    dfrac = sim.disco_frac(N_SLOTS, n_runs=20)
+    assert (np.diff(dfrac) >= 0).all()
+    assert dfrac[0] >= 0.0 and dfrac[-1] <= 1.0
+
+
+def test_hop_channel():
+    h = np.arange(HOP_PERIOD)
+    for n_channels in [2, 3]:
+        chan = hop_channel(h, n_channels)
+        # Channels are used evenly
+        counts = np.bincount(chan, minlength=n_channels)
+        assert (np.abs(counts / HOP_PERIOD - 1 / n_channels) < 0.01).all()
+        # Sequences of nodes with different offsets are uncorrelated
+        for offset in [1, 17, 12345]:
+            same = np.mean(chan == hop_channel(h + offset, n_channels))
+            assert abs(same - 1 / n_channels) < 0.02
+
+
+@pytest.mark.parametrize("n_channels", [1, 3])
+def test_matches_model(n_channels):
+    """Simulated discovery follows the analytical model of the channels"""
+    m = Model(
+        0.3, "Geometric", 25, n_nodes=2, n_slots=N_SLOTS + 100, n_jobs=1,
+        n_channels=n_channels,
+    )
+    s = Simulation(0.3, "Geometric", 25, n_nodes=2, n_channels=n_channels, seed=1)
+    cdf_model = np.sum(m.cdf(), axis=1)
+    cdf_sim = s.disco_frac(N_SLOTS, n_runs=300)
+    for slot in [200, 500, 1000]:
+        assert abs(cdf_model[slot] - cdf_sim[slot]) < 0.1
+
+
+def test_channels_reduce_collisions():
+    """Channels only pay off when many nodes contend for the same slots"""
+    lat = dict()
+    for n_channels in [1, 3]:
+        s = Simulation(0.5, "Geometric", 5, n_nodes=24, n_channels=n_channels, seed=1)
+        lat[n_channels] = s.disco_latency(N_SLOTS, n_runs=5)
+    assert lat[3] < lat[1]
+
+
+def test_grid_adjacency():
+    adj = grid_adjacency(4, 2, radius=1.0)
+    assert adj.shape == (8, 8)
+    assert (adj == adj.T).all() and not adj.diagonal().any()
+    # Corners hear two neighbors, the others three
+    assert sorted(np.sum(adj, axis=1)) == [2, 2, 2, 2, 3, 3, 3, 3]
+
+
+def test_gossip():
+    """Gossip reveals links between neighbors that never met the node"""
+    adj = grid_adjacency(4, 2, radius=1.5)
+    s = Simulation(0.3, "Geometric", 25, adjacency=adj, seed=1)
+    assert s.n_nodes == 8 and len(s.links()) == 16
+
+    t_full, _ = s.run_gossip(N_SLOTS, 0)
+    # Without gossip, nodes only learn links they took part in
+    assert (t_full == N_SLOTS).all()
+
+    frac = s.topo_frac(N_SLOTS, 0, n_runs=10)
+    frac_gossip = s.topo_frac(N_SLOTS, 4, n_runs=10)
+    assert (np.diff(frac_gossip) >= 0).all()
+    assert frac_gossip[-1] > frac[-1] + 0.2
+
+
+def test_subslots_match_model():
+    """Sub-slots cut collisions in dense cliques as the model predicts"""
+    lat = dict()
+    for n_subslots in [1, 4]:
+        m = Model(
+            0.5, "Geometric", 5, n_nodes=12, n_slots=N_SLOTS + 100, n_jobs=1,
+            n_subslots=n_subslots,
+        )
+        s = Simulation(0.5, "Geometric", 5, n_nodes=12, n_subslots=n_subslots, seed=1)
+        cdf_model = np.sum(m.cdf(), axis=1) / len(m.links())
+        cdf_sim = s.disco_frac(N_SLOTS, n_runs=20)
+        for slot in [100, 300, 1000]:
+            assert abs(cdf_model[slot] - cdf_sim[slot]) < 0.1
+        lat[n_subslots] = s.disco_latency(N_SLOTS, n_runs=5)
+    assert lat[4] < lat[1]